@@ -1,58 +1,244 @@
 #include "../common_pfx.hpp"
 
+#include <algorithm>
+
 namespace cpfx
 {
-struct ContainerCommand : pfx::Command
+/// Identifies the calls of a function, see SlotCommand.
+struct Scope
+{
+};
+
+/// A running function call.
+struct Frame
+{
+    const Scope *scope; // The function running.
+    size_t base;        // Where its slots start in frameSlots().
+};
+
+/// The parameters and locals of the running calls, the frames share it.
+static std::vector<pfx::Value> &frameSlots()
+{
+    static thread_local std::vector<pfx::Value> slots;
+    return slots;
+}
+
+/// The running function calls, the innermost is on the top.
+static std::vector<Frame> &frames()
+{
+    static thread_local std::vector<Frame> calls;
+    return calls;
+}
+
+/// The functions whose bodies are being checked for purity.
+static std::vector<const Scope *> &checkedScopes()
+{
+    static thread_local std::vector<const Scope *> scopes;
+    return scopes;
+}
+
+/// The arguments of the tail calls, kept until they are all evaluated.
+static std::vector<pfx::Value> &tailArguments()
+{
+    static thread_local std::vector<pfx::Value> arguments;
+    return arguments;
+}
+
+/**
+ * Reads a parameter or a local of a function: a slot in the frame of the
+ * innermost call of the function on this thread.
+ *
+ * @remarks
+ *  The function bodies refer to their parameters and locals through private
+ * command nodes bound to these, see SlotResolver.
+ */
+struct SlotCommand : pfx::FixedCommand
 {
-    pfx::NodeRef ref;
+    std::shared_ptr<const Scope> scope;
+    size_t index;
 
-    ContainerCommand() : ContainerCommand(pfx::NullNode::instance)
+    SlotCommand(std::shared_ptr<const Scope> scope, size_t index)
+        : FixedCommand(pfx::Signature()), scope(std::move(scope)), index(index)
     {
+        setTag<SlotCommand>();
     }
 
-    ContainerCommand(pfx::NodeRef ref) : ref(std::move(ref))
+    /// @return The slot, nullptr if the function is not running here.
+    pfx::Value *find() const
     {
+        std::vector<Frame> &calls = frames();
+        for (size_t i = calls.size(); i-- > 0;)
+        {
+            if (calls[i].scope == scope.get())
+            {
+                return &frameSlots()[calls[i].base + index];
+            }
+        }
+        return nullptr;
+    }
+
+    pfx::Value apply(const pfx::Arguments &) override
+    {
+        const pfx::Value *slot = find();
+        if (!slot)
+        {
+            throw pfx::error::RuntimeError(
+                pfx::Position(),
+                "The function of this parameter or local is not running.");
+        }
+        return *slot;
     }
 
-    pfx::NodeRef execute(pfx::ArgIterator &) override
+    // Only the calls of its function have the frame, so it's pure within the
+    // body of the function. Other threads can't read it.
+    bool isPure(pfx::PurityCheck &) const override
     {
-        return ref;
+        const std::vector<const Scope *> &checked = checkedScopes();
+        return std::find(checked.begin(), checked.end(), scope.get()) !=
+               checked.end();
     }
 };
 
-void let(pfx::CommandNode &cmd, pfx::NodeRef value)
+/**
+ * @param [in] node A command node.
+ *
+ * @return The slot the node reads, nullptr if it's not a parameter or a local.
+ */
+static const SlotCommand *slotOf(const pfx::CommandNode &node)
 {
-    auto *varContainer = dynamic_cast<ContainerCommand *>(cmd.command.get());
-    if (!varContainer)
+    const std::shared_ptr<pfx::Command> &command = node.getCommand();
+    return command ? command->as<SlotCommand>() : nullptr;
+}
+
+/**
+ * Copies the body of a function with its parameters and locals replaced by
+ * the nodes of their slots.
+ *
+ * @remarks
+ *  The names are matched by node, the context has one node for each name.
+ * Only the groups and the calls containing them are copied, the rest is
+ * shared with the original body. The copied groups get bytecode when the
+ * originals had it.
+ */
+class SlotResolver
+{
+    std::unordered_map<const pfx::Node *, pfx::CommandRef> slots;
+
+public:
+    /**
+     * Replaces a name with a slot. The later one wins for the same name.
+     *
+     * @param [in] name The node of the name.
+     * @param [in] slot The node of the slot.
+     */
+    void add(const pfx::Node &name, pfx::CommandRef slot)
     {
-        auto tmp = std::make_shared<ContainerCommand>();
-        cmd.command = tmp;
-        varContainer = tmp.get();
+        slots[&name] = std::move(slot);
     }
-    varContainer->ref = std::move(value);
+
+    /**
+     * @param [in] node The node to resolve.
+     * @param [in] position Where the node starts, for the depth errors.
+     *
+     * @return The node with the names replaced, the node itself if it
+     * doesn't contain them.
+     */
+    pfx::NodeRef resolve(const pfx::NodeRef &node,
+                         const pfx::Position &position);
+};
+
+
+pfx::NodeRef SlotResolver::resolve(const pfx::NodeRef &node,
+                                   const pfx::Position &position)
+{
+    auto found = slots.find(node.get());
+    if (found != slots.end()) return found->second;
+
+    pfx::GroupNode *group = node->as<pfx::GroupNode>();
+    pfx::CallNode *call = node->as<pfx::CallNode>();
+    if (!group && !call) return node;
+
+    pfx::DepthLimit::Guard guard(position);
+    const std::pmr::vector<pfx::NodeInfo> &children =
+        group ? group->nodes : call->args;
+    auto target = call ? slots.find(call->target.get()) : slots.end();
+    std::vector<pfx::NodeRef> resolved;
+    bool changed = target != slots.end();
+    for (const pfx::NodeInfo &child : children)
+    {
+        resolved.push_back(resolve(child.node, child.start));
+        changed |= resolved.back().get() != child.node.get();
+    }
+    if (!changed) return node;
+
+    std::pmr::vector<pfx::NodeInfo> copied(children.begin(), children.end());
+    for (size_t i = 0; i < copied.size(); i++)
+    {
+        copied[i].node = std::move(resolved[i]);
+    }
+    if (call)
+    {
+        auto copy = pfx::makeNode<pfx::CallNode>(
+            target != slots.end() ? target->second : call->target, call->modes,
+            call->position, std::pmr::get_default_resource());
+        copy->args = std::move(copied);
+        return copy;
+    }
+    pfx::GroupRef copy = pfx::createGroup();
+    copy->nodes = std::move(copied);
+    copy->source = group->source;
+    if (group->bytecode)
+    {
+        copy->bytecode = std::make_shared<const pfx::Bytecode>(*copy);
+    }
+    return copy;
 }
 
-struct LetCommand : pfx::Command
+struct LetCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    LetCommand() : FixedCommand({pfx::ArgMode::Fetch, pfx::ArgMode::Evaluate})
     {
-        auto pos = iter.getPosition();
-        auto variable = iter.fetchNext()->asCommand();
-        auto value = iter.evaluateNext();
+    }
 
-        if (!variable) pos.raiseErrorHere("This is not a variable!");
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto variable = args[0].asCommand();
+        auto &value = args[1];
 
-        let(*variable, value);
+        if (!variable)
+        {
+            args.getPosition(0).raiseErrorHere("This is not a variable!");
+        }
+
+        // The parameters and locals are in the frame of the call.
+        if (const SlotCommand *slot = slotOf(*variable))
+        {
+            pfx::Value *target = slot->find();
+            if (!target)
+            {
+                args.getPosition(0).raiseErrorHere(
+                    "The function of this variable is not running.");
+            }
+            *target = value;
+            return value;
+        }
+
+        variable->setValue(value);
 
         return value;
     }
 };
 
-struct ListCommand : pfx::Command
+struct ListCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    ListCommand() : FixedCommand({pfx::ArgMode::Fetch})
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        auto gn = iter.fetchNext()->asGroup();
+        auto gn = args[0].asGroup();
 
         if (gn) return gn->evaluateAll();
 
@@ -60,124 +246,124 @@ struct ListCommand : pfx::Command
     }
 };
 
-struct TRecRequest
+/// Pushes the frame of a function call, pops it on return.
+class FrameGuard
 {
-    pfx::NodeRef group;
-};
+    size_t depth;
 
-struct FunctionRunner : pfx::Command
-{
-    std::vector<pfx::CommandRef> parameters;
-    std::vector<pfx::CommandRef> locals;
-    pfx::GroupRef body;
-
-    FunctionRunner(const pfx::GroupRef &parameters, const pfx::GroupRef &locals,
-                   pfx::GroupRef body)
-        : body(std::move(body))
+public:
+    FrameGuard(const Scope *scope, size_t slotCount, const pfx::Arguments &args)
+        : depth(frames().size())
     {
-        for (auto x : parameters->nodes)
-        {
-            this->parameters.push_back(x.node->asCommand());
-        }
-
-        for (auto x : locals->nodes)
+        // The arguments then the locals, starting as null.
+        std::vector<pfx::Value> &slots = frameSlots();
+        frames().push_back(Frame{scope, slots.size()});
+        for (size_t i = 0; i < slotCount; i++)
         {
-            this->locals.push_back(x.node->asCommand());
+            slots.push_back(i < args.size() ? std::move(args[i])
+                                            : pfx::Value());
         }
     }
 
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    ~FrameGuard()
     {
-        std::vector<pfx::CommandCallbackRef> savedVariables;
-        std::vector<pfx::CommandCallbackRef> savedLocals;
-        std::vector<pfx::NodeRef> args;
-
-        int nParams = parameters.size();
-        while (nParams-- > 0)
-        {
-            args.push_back(iter.evaluateNext());
-        }
+        // An error may leave the tail call of the body unanswered.
+        pfx::TailCall::cancel();
 
-        // Save previous meanings of the formal arguments and locals and
-        // override them with new meanings.
+        std::vector<Frame> &calls = frames();
+        frameSlots().resize(calls[depth].base);
+        calls.resize(depth);
+    }
+};
 
-        int i = 0;
-        for (auto &x : parameters)
-        {
-            auto cn = x->asCommand();
-            savedVariables.push_back(cn->command);
-            cn->command = std::make_shared<ContainerCommand>(args[i++]);
-        }
+struct FunctionRunner : pfx::FixedCommand
+{
+    // Identifies the frames of the calls, the slot nodes keep it too.
+    std::shared_ptr<const Scope> scope = std::make_shared<const Scope>();
+    size_t parameterCount;
+    // The parameters then the locals.
+    size_t slotCount;
+    // Refers to the parameters and locals through their slots.
+    pfx::GroupRef body;
 
-        for (auto &x : locals)
-        {
-            auto cn = x->asCommand();
-            savedLocals.push_back(cn->command);
-            cn->command = std::make_shared<ContainerCommand>();
-        }
+    FunctionRunner(const pfx::GroupRef &parameters, const pfx::GroupRef &locals,
+                   const pfx::GroupRef &body)
+        : FixedCommand(pfx::Signature(std::vector<pfx::ArgMode>(
+              parameters->nodes.size(), pfx::ArgMode::Evaluate))),
+          parameterCount(parameters->nodes.size()),
+          slotCount(parameterCount + locals->nodes.size())
+    {
+        setTag<FunctionRunner>();
+        setPure();
 
-        // Execute the body
-        pfx::NodeRef currentBody = body;
-        pfx::NodeRef result;
-        for (;;)
+        SlotResolver resolver;
+        size_t index = 0;
+        for (const pfx::GroupRef &names : {parameters, locals})
         {
-            try
-            {
-                result = currentBody->evaluate();
-                break;
-            }
-            catch (const TRecRequest &trecRequest)
+            for (const pfx::NodeInfo &name : names->nodes)
             {
-                /** The tail recursion request can come from many layers deep.
-                 * Throwing an exception allows us to unwind those layers and
-                 * return to nearest executing function. And do the body swap
-                 * there.
-                 */
-                currentBody = trecRequest.group;
+                resolver.add(*name.node,
+                             pfx::makeNode<pfx::CommandNode>(
+                                 std::make_shared<SlotCommand>(scope, index++),
+                                 name.node->toString()));
             }
         }
+        this->body = resolver.resolve(body, pfx::Position())->asGroup();
+    }
 
-        // Restore the meanings of the overridden stuff.
-        i = 0;
-        for (auto &x : parameters)
-        {
-            auto cn = x->asCommand();
-            cn->command = savedVariables[i++];
-        }
+    // The parameters and locals are its own slots, only the body matters.
+    bool isPure(pfx::PurityCheck &check) const override
+    {
+        std::vector<const Scope *> &checked = checkedScopes();
+        checked.push_back(scope.get());
+        bool pure = check.isPure(*body);
+        checked.pop_back();
+        return pure;
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        FrameGuard guard(scope.get(), slotCount, args);
 
-        i = 0;
-        for (auto &x : locals)
+        // Execute the body
+        const pfx::Node *currentBody = body.get();
+        pfx::NodeRef requested;
+        for (;;)
         {
-            auto cn = x->asCommand();
-            cn->command = savedLocals[i++];
+            pfx::Value result = currentBody->evaluateValue();
+            if (!pfx::TailCall::pending()) return result;
+
+            /** The tail recursion request can come from many layers deep.
+             * They return null while it's pending, so it unwinds to the
+             * nearest executing function. The body swap is done there.
+             */
+            requested = pfx::TailCall::take();
+            currentBody = requested.get();
         }
-
-        // Done.
-        return result;
     }
 };
 
-std::shared_ptr<pfx::Command> createLambda(pfx::ArgIterator &iter)
+std::shared_ptr<pfx::Command> createLambda(const pfx::Arguments &args)
 {
-    pfx::Position pos = iter.getPosition();
-    pfx::GroupRef argsGroup = iter.fetchNext()->asGroup();
+    pfx::GroupRef argsGroup = args[0].asGroup();
     if (!argsGroup)
     {
-        pos.raiseErrorHere("Group node expected (for arguments)");
+        args.getPosition(0).raiseErrorHere(
+            "Group node expected (for arguments)");
     }
 
-    pos = iter.getPosition();
-    pfx::GroupRef locals = iter.fetchNext()->asGroup();
+    pfx::GroupRef locals = args[1].asGroup();
     if (!locals)
     {
-        pos.raiseErrorHere("Group node expected (for locals) ");
+        args.getPosition(1).raiseErrorHere(
+            "Group node expected (for locals) ");
     }
 
-    pos = iter.getPosition();
-    pfx::GroupRef body = iter.fetchNext()->asGroup();
+    pfx::GroupRef body = args[2].asGroup();
     if (!body)
     {
-        pos.raiseErrorHere("Group node expected (for function body)");
+        args.getPosition(2).raiseErrorHere(
+            "Group node expected (for function body)");
     }
 
     for (auto arg : argsGroup->nodes)
@@ -198,110 +384,323 @@ std::shared_ptr<pfx::Command> createLambda(pfx::ArgIterator &iter)
     return std::make_shared<FunctionRunner>(argsGroup, locals, body);
 }
 
-struct LambdaCommand : pfx::Command
+struct LambdaCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    LambdaCommand()
+        : FixedCommand({pfx::ArgMode::Fetch, pfx::ArgMode::Fetch,
+                        pfx::ArgMode::Fetch})
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        return pfx::createCommand(createLambda(iter));
+        return pfx::createCommand(createLambda(args));
     }
 };
 
-struct FetchCommand : pfx::Command
+struct FetchCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    FetchCommand() : FixedCommand({pfx::ArgMode::Fetch})
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        return iter.fetchNext();
+        return args[0];
     }
 };
 
-struct ToIntCommand : pfx::Command
+/**
+ * Quickens a conversion for an argument that already has the type it converts
+ * to, the fast path returns the argument as is.
+ */
+template <class T, pfx::NodeType type>
+const pfx::Quickening *quickenConversion(const pfx::Arguments &args)
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    static const pfx::Quickening identity = pfx::Quickening::of<T>(
+        {type}, [](const pfx::Arguments &args) { return args[0]; });
+    return args[0].getType() == type ? &identity : nullptr;
+}
+
+struct ToIntCommand : pfx::FixedCommand
+{
+    ToIntCommand() : FixedCommand({pfx::ArgMode::Evaluate})
+    {
+        setTag<ToIntCommand>();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        auto arg = iter.evaluateNext();
+        return pfx::Value(args[0].toInteger());
+    }
 
-        return pfx::createInteger(arg->toInteger());
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenConversion<ToIntCommand, pfx::NodeType::Integer>(args);
     }
 };
 
-struct ToFloatCommand : pfx::Command
+struct ToFloatCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    ToFloatCommand() : FixedCommand({pfx::ArgMode::Evaluate})
     {
-        auto arg = iter.evaluateNext();
+        setTag<ToFloatCommand>();
+        setPure();
+    }
 
-        return pfx::createFloat(arg->toDouble());
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        return pfx::Value(args[0].toDouble());
+    }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenConversion<ToFloatCommand,
+                                 pfx::NodeType::FloatingPoint>(args);
     }
 };
 
-struct ToStringCommand : pfx::Command
+struct ToStringCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    ToStringCommand() : FixedCommand({pfx::ArgMode::Evaluate})
     {
-        auto arg = iter.evaluateNext();
+        setTag<ToStringCommand>();
+        setPure();
+    }
 
-        return pfx::createString(arg->toString());
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        return pfx::createString(args[0].toString());
+    }
+
+    // The strings are immutable, so a string can be returned without a copy.
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenConversion<ToStringCommand, pfx::NodeType::String>(
+            args);
     }
 };
 
-struct BindCommand : pfx::Command
+struct BindCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    BindCommand()
+        : FixedCommand({pfx::ArgMode::Fetch, pfx::ArgMode::Evaluate})
     {
-        auto pos = iter.getPosition();
-        auto bindeeCmd = iter.fetchNext()->asCommand();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto bindeeCmd = args[0].asCommand();
 
         if (!bindeeCmd)
         {
-            pos.raiseErrorHere("Command expected.");
+            args.getPosition(0).raiseErrorHere("Command expected.");
         }
 
-        pos = iter.getPosition();
-        auto toBindCmd = iter.evaluateNext()->asCommand();
+        auto toBindCmd = args[1].asCommand();
         if (!toBindCmd)
         {
-            pos.raiseErrorHere("Command expected.");
+            args.getPosition(1).raiseErrorHere("Command expected.");
+        }
+
+        // The parameters and locals are bound to the value in their slot.
+        const SlotCommand *from = slotOf(*toBindCmd);
+        const pfx::Value *value = nullptr;
+        if (from)
+        {
+            value = from->find();
+            if (!value)
+            {
+                args.getPosition(1).raiseErrorHere(
+                    "The function of this variable is not running.");
+            }
+        }
+        else if (toBindCmd->isVariable())
+        {
+            value = &toBindCmd->getValue();
         }
 
-        bindeeCmd->command = toBindCmd->command;
+        if (const SlotCommand *slot = slotOf(*bindeeCmd))
+        {
+            pfx::Value *target = slot->find();
+            if (!value || !target)
+            {
+                args.getPosition(0).raiseErrorHere(
+                    "A parameter or local can only be bound to a value of "
+                    "its running function.");
+            }
+            *target = *value;
+        }
+        else if (value)
+        {
+            bindeeCmd->setValue(*value);
+        }
+        else
+        {
+            bindeeCmd->setCommand(toBindCmd->getCommand());
+        }
 
         return pfx::NullNode::instance;
     };
 };
 
+/**
+ * Applies a command to the elements of a group on the thread pool.
+ *
+ * @remarks
+ *  The group is split into chunks, a few for each worker so the faster ones
+ * can steal the rest. Each chunk runs in its own environment, a child of the
+ * caller's, so the variables the chunks set don't clash. When the command or
+ * an element is not pure (see PurityCheck), the elements are mapped one by one
+ * on the calling thread instead.
+ */
+struct PMapCommand : pfx::FixedCommand
+{
+    std::shared_ptr<pfx::ThreadPool> pool;
+
+    explicit PMapCommand(std::shared_ptr<pfx::ThreadPool> pool)
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate}),
+          pool(std::move(pool))
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        pfx::CommandRef function = args[0].asCommand();
+        std::shared_ptr<pfx::Command> command =
+            function ? function->getCommand() : nullptr;
+        if (!command)
+        {
+            args.getPosition(0).raiseErrorHere("Command node expected.");
+        }
+        pfx::GroupRef group = args[1].asGroup();
+        if (!group)
+        {
+            args.getPosition(1).raiseErrorHere("Group node expected.");
+        }
+
+        const std::pmr::vector<pfx::NodeInfo> &nodes = group->nodes;
+        size_t count = nodes.size();
+        std::vector<pfx::Value> results(count);
+        auto map = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                // The command reads the element as its argument.
+                pfx::ArgIterator iterator(nodes.begin() + i,
+                                          nodes.begin() + i + 1);
+                results[i] = command->call(iterator);
+            }
+        };
+
+        pfx::PurityCheck check;
+        if (!check.isPure(*function) || !check.isPure(*group))
+        {
+            map(0, count);
+        }
+        else
+        {
+            size_t chunkCount = std::min(count, pool->size() * 8 + 1);
+            size_t chunkSize =
+                chunkCount ? (count + chunkCount - 1) / chunkCount : 0;
+            const pfx::Environment *caller = pfx::Environment::current();
+            pool->run(chunkCount, [&](size_t chunk) {
+                pfx::Environment environment(caller);
+                pfx::Environment::Scope scope(environment);
+                map(chunk * chunkSize,
+                    std::min(count, (chunk + 1) * chunkSize));
+            });
+        }
+
+        pfx::GroupRef mapped = pfx::createGroup();
+        mapped->nodes.reserve(count);
+        for (pfx::Value &result : results)
+        {
+            mapped->nodes.emplace_back(result.toNode());
+        }
+        return mapped;
+    }
+};
+
+/**
+ * Evaluates the elements of a group like list, but in parallel on the thread
+ * pool when they are all pure, see GroupNode::evaluateAll().
+ */
+struct PListCommand : pfx::FixedCommand
+{
+    std::shared_ptr<pfx::ThreadPool> pool;
+
+    explicit PListCommand(std::shared_ptr<pfx::ThreadPool> pool)
+        : FixedCommand({pfx::ArgMode::Fetch}), pool(std::move(pool))
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto gn = args[0].asGroup();
+
+        if (gn) return gn->evaluateAll(*pool);
+
+        return gn;
+    }
+};
+
 struct TRecCommand : pfx::Command
 {
     pfx::NodeRef execute(pfx::ArgIterator &iter) override
     {
         auto pos = iter.getPosition();
-        auto cmd = iter.fetchNext()->asCommand();
+        auto *cmd = iter.fetchNextNode().as<pfx::CommandNode>();
 
         if (!cmd)
         {
             pos.raiseErrorHere("Command node expected.");
         }
 
-        auto *fr = dynamic_cast<FunctionRunner *>(cmd->command.get());
+        auto *fr = cmd->isVariable() ? nullptr
+                                     : cmd->getCommand()->as<FunctionRunner>();
         if (!fr)
         {
             pos.raiseErrorHere("Runnable function expected..");
         }
 
-        std::vector<pfx::NodeRef> args;
-        auto nParams = fr->parameters.size();
+        if (frames().empty())
+        {
+            pos.raiseErrorHere("Tail call outside of a function.");
+        }
 
-        while (nParams-- > 0)
+        // The arguments are kept aside until they are all evaluated.
+        std::vector<pfx::Value> &arguments = tailArguments();
+        size_t base = arguments.size();
+        for (size_t i = 0; i < fr->parameterCount; i++)
+        {
+            arguments.push_back(iter.evaluateNextValue());
+        }
+        if (pfx::TailCall::pending())
         {
-            args.push_back(iter.evaluateNext());
+            // An argument made the tail call instead.
+            arguments.resize(base);
+            return pfx::NullNode::instance;
         }
 
-        auto i = int(0);
-        for (auto &x : fr->parameters)
+        // The frame of the running call becomes the frame of the callee.
+        Frame &frame = frames().back();
+        std::vector<pfx::Value> &slots = frameSlots();
+        slots.resize(frame.base + fr->slotCount);
+        for (size_t i = 0; i < fr->slotCount; i++)
         {
-            let(*x->asCommand(), args[i++]);
+            slots[frame.base + i] = i < fr->parameterCount
+                                        ? std::move(arguments[base + i])
+                                        : pfx::Value();
         }
+        frame.scope = fr->scope.get();
+        arguments.resize(base);
 
-        throw TRecRequest{fr->body};
+        return pfx::TailCall::request(fr->body).toNode();
     }
 };
 
@@ -361,8 +760,11 @@ void applyCommonPfx(pfx::Context &ctx)
      * be used locally in the lambda. The function body will be evaluated when
      * the lambda is invoked.
      *
-     * All the arguments and locals value is saved before the evaluation to
-     * shadow global variables.
+     * The arguments and locals are resolved when the lambda is created: the
+     * body refers to them by their slot in the frame of the call, so they
+     * shadow the global variables but the functions called from the body
+     * don't see them. A lambda created in the body of a function can read the
+     * slots of that function while it runs.
      */
     ctx.setCommand("lambda", std::make_shared<LambdaCommand>());
 
@@ -382,6 +784,30 @@ void applyCommonPfx(pfx::Context &ctx)
      */
     ctx.setCommand("list", std::make_shared<ListCommand>());
 
+    /**
+     * pmap >command (group) --> (results)
+     *
+     * Applies the command to each element of the group, like
+     * ( command element1 ) ( command element2 ) ... but on the threads of the
+     * context, see Context::getThreadPool(). The results are in the order of
+     * the elements. It runs in parallel when the command and the elements are
+     * pure (see Command::isPure()), the variables they set are not seen by the
+     * caller then. Otherwise the elements are mapped one by one, in order.
+     */
+    ctx.setCommand("pmap",
+                   std::make_shared<PMapCommand>(ctx.getSharedThreadPool()));
+
+    /**
+     * plist *(group) --> (evaluated-group)
+     * plist any --> any
+     *
+     * Like list, but evaluates the nodes on the threads of the context when
+     * all the commands they run are pure, see Command::isPure(). Otherwise it
+     * evaluates them one by one, like list.
+     */
+    ctx.setCommand("plist",
+                   std::make_shared<PListCommand>(ctx.getSharedThreadPool()));
+
     /**
      * string node --> "stringValue"
      *
@@ -395,13 +821,21 @@ void applyCommonPfx(pfx::Context &ctx)
      * Tail recursive call to the given function. Sort of.
      * The argument node must be a command node and must be bound to a function.
      *
-     * It then evaluates the required amount of arguments, alters the given
-     * variables (without saving them!) and then sets the current argument
-     * iterator to point to its function body. This way the function can be
-     * executed without recursion and without the risk of running out of stack.
+     * It then evaluates the required amount of arguments, replaces the frame
+     * of the running call with the frame of the function and then requests a
+     * tail call of its function body. The evaluation returns to the running
+     * function, which continues with the body. This way the function can be
+     * executed without recursion and without the risk of running out of
+     * stack.
+     *
+     * It should be the last thing the function does: the commands still
+     * waiting for their arguments get nulls and may not run at all.
      *
      */
     ctx.setCommand("trec", std::make_shared<TRecCommand>());
+
+    // These are fixed, so they get the fast lookup.
+    ctx.sealCommands();
 }
 
 } // namespace cpfx
@@ -413,6 +847,31 @@ void applyCommonPfx(pfx::Context &ctx)
 #include <assert.h>
 #include <stdarg.h>
 
+#include <thread>
+
+// Counts the allocations, so the tests can check what doesn't allocate.
+static std::atomic<size_t> allocations(0);
+
+// Not inlined, so the compiler doesn't pair free() with new.
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    allocations++;
+    void *memory = malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory,
+                                                size_t) noexcept
+{
+    free(memory);
+}
+
 std::string ssprintfv(const char *format, va_list args)
 {
     va_list args2;
@@ -493,21 +952,64 @@ struct MulCommand : pfx::Command
         pfx::NodeRef a = iter.evaluateNext();
         pfx::NodeRef b = iter.evaluateNext();
 
-        return std::make_shared<pfx::FloatNode>(a->toDouble() * b->toDouble());
+        return pfx::makeNode<pfx::FloatNode>(a->toDouble() * b->toDouble());
+    }
+};
+
+
+struct IntegerCommand : pfx::FixedCommand
+{
+    int (*operation)(int, int);
+
+    IntegerCommand(int (*operation)(int, int))
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate}),
+          operation(operation)
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        return pfx::Value(operation(args[0].toInteger(), args[1].toInteger()));
+    }
+};
+
+struct IfCommand : pfx::FixedCommand
+{
+    IfCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Fetch,
+                        pfx::ArgMode::Fetch})
+    {
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        return args[args[0].toInteger() ? 1 : 2].getNode()->evaluateValue();
     }
 };
 
 
 void run(std::string str)
 {
-    pfx::Input input("", str);
-    pfx::Context ctx;
+    // Run on both the tree walker and the bytecode engine, with and without
+    // linking the calls.
+    for (bool bytecode : {false, true})
+    {
+        for (bool linking : {false, true})
+        {
+            pfx::Input input("", str);
+            pfx::Context ctx;
 
-    cpfx::applyCommonPfx(ctx);
-    ctx.setCommand("assert", std::make_shared<AssertCommand>());
-    ctx.setCommand("*", std::make_shared<MulCommand>());
+            cpfx::applyCommonPfx(ctx);
+            ctx.setCommand("assert", std::make_shared<AssertCommand>());
+            ctx.setCommand("*", std::make_shared<MulCommand>());
+            ctx.setBytecodeCompilation(bytecode);
+            ctx.setCallLinking(linking);
 
-    ctx.compileCode(input)->evaluate();
+            ctx.compileCode(input)->evaluate();
+        }
+    }
 }
 
 
@@ -540,6 +1042,365 @@ int main()
             assert float "7" 7.0
             assert int "7" 7
         )");
+
+        printf("Test 5\n");
+        // The calls of a function don't allocate.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setCommand("if", std::make_shared<IfCommand>());
+            ctx.setCommand("<", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return int(a < b); }));
+            ctx.setCommand("+", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a + b; }));
+            ctx.setCommand("-", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a - b; }));
+            ctx.setCommand("times", std::make_shared<IntegerCommand>(
+                                        [](int a, int b) { return a * b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            pfx::Input functions("", R"(
+                bind fact lambda ( n ) ( ) (
+                    if < n 2 ( 1 ) ( times n fact - n 1 )
+                )
+                bind fibo lambda ( n ) ( a ) (
+                    let a - n 1
+                    if < n 2 ( n ) ( + fibo a fibo - a 1 )
+                )
+            )");
+            ctx.compileCode(functions)->evaluate();
+            pfx::Input calls("", "( fact 10 ) ( fibo 15 )");
+            pfx::GroupRef gn = ctx.compileCode(calls);
+            const pfx::Node *fact = gn->nodes[0].node.get();
+            const pfx::Node *fibo = gn->nodes[1].node.get();
+
+            // The first run grows the stacks.
+            assert(fact->evaluateValue().toInteger() == 3628800);
+            assert(fibo->evaluateValue().toInteger() == 610);
+            size_t before = allocations;
+            assert(fact->evaluateValue().toInteger() == 3628800);
+            assert(fibo->evaluateValue().toInteger() == 610);
+            assert(allocations == before);
+
+            // The recursive functions refer to themselves, break the cycles.
+            ctx.setCommand("fact", nullptr);
+            ctx.setCommand("fibo", nullptr);
+        }
+
+        printf("Test 6\n");
+        // The tail calls iterate without growing the stack or allocating.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setCommand("if", std::make_shared<IfCommand>());
+            ctx.setCommand("-", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a - b; }));
+            ctx.setCommand("+", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a + b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            pfx::Input functions("", R"(
+                bind count lambda ( n sum ) ( ) (
+                    if n ( trec count - n 1 + sum 1 ) ( sum )
+                )
+            )");
+            ctx.compileCode(functions)->evaluate();
+            pfx::Input calls("", "( count 10 0 ) ( count 100000 0 )");
+            pfx::GroupRef gn = ctx.compileCode(calls);
+            const pfx::Node *shortCount = gn->nodes[0].node.get();
+            const pfx::Node *longCount = gn->nodes[1].node.get();
+
+            assert(shortCount->evaluateValue().toInteger() == 10);
+            size_t before = allocations;
+            assert(longCount->evaluateValue().toInteger() == 100000);
+            assert(allocations == before);
+
+            // Outside of a function there is nothing to continue.
+            pfx::Input outside("", "trec count 1 2");
+            bool thrown = false;
+            try
+            {
+                ctx.compileCode(outside)->evaluate();
+            }
+            catch (const pfx::Error &)
+            {
+                thrown = true;
+            }
+            assert(thrown);
+            assert(!pfx::TailCall::pending());
+
+            ctx.setCommand("count", nullptr);
+        }
+
+        printf("Test 7\n");
+        // One compiled program runs on several threads, each with its own
+        // bindings for the parameters.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setCommand("if", std::make_shared<IfCommand>());
+            ctx.setCommand("<", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return int(a < b); }));
+            ctx.setCommand("+", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a + b; }));
+            ctx.setCommand("-", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a - b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            pfx::Input functions("", R"(
+                bind fibo lambda ( n ) ( a ) (
+                    let a - n 1
+                    if < n 2 ( n ) ( + fibo a fibo - a 1 )
+                )
+                bind count lambda ( n sum ) ( ) (
+                    if n ( trec count - n 1 + sum 1 ) ( sum )
+                )
+            )");
+            ctx.compileCode(functions)->evaluate();
+            pfx::Input calls(
+                "", "( fibo 15 ) ( fibo 16 ) ( count 1000 0 ) ( fibo 17 )");
+            pfx::GroupRef gn = ctx.compileCode(calls);
+
+            const int expected[] = {610, 987, 1000, 1597};
+            int results[4] = {};
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 4; i++)
+            {
+                threads.emplace_back([&gn, &results, i] {
+                    pfx::Environment environment;
+                    for (int run = 0; run < 20; run++)
+                    {
+                        results[i] =
+                            environment.evaluate(*gn->nodes[i].node)
+                                .toInteger();
+                    }
+                });
+            }
+            for (std::thread &thread : threads)
+            {
+                thread.join();
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                assert(results[i] == expected[i]);
+            }
+
+            ctx.setCommand("fibo", nullptr);
+            ctx.setCommand("count", nullptr);
+        }
+
+        printf("Test 8\n");
+        // pmap keeps the order of the elements, nests and reports the errors
+        // of the workers.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setThreadCount(3);
+            ctx.setCommand("times", std::make_shared<IntegerCommand>(
+                                        [](int a, int b) { return a * b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            std::string elements;
+            for (int i = 0; i < 10000; i++)
+            {
+                elements += " " + std::to_string(i);
+            }
+            pfx::Input input("", R"(
+                bind square lambda ( x ) ( ) ( times x x )
+                pmap fetch square fetch ()" + elements + R"( )
+            )");
+            pfx::GroupRef squares =
+                ctx.compileCode(input)->evaluate()->asGroup();
+            assert(squares && (squares->nodes.size() == 10000));
+            for (int i = 0; i < 10000; i++)
+            {
+                assert(squares->nodes[i].node->toInteger() == i * i);
+            }
+
+            pfx::Input nested("", R"(
+                pmap lambda ( g ) ( ) ( pmap fetch square g )
+                    fetch ( ( fetch ( 1 2 ) ) ( fetch ( 3 ) ) ( fetch ( ) ) )
+            )");
+            pfx::GroupRef groups =
+                ctx.compileCode(nested)->evaluate()->asGroup();
+            assert(groups && (groups->nodes.size() == 3));
+            pfx::GroupRef first = groups->nodes[0].node->asGroup();
+            pfx::GroupRef second = groups->nodes[1].node->asGroup();
+            pfx::GroupRef third = groups->nodes[2].node->asGroup();
+            assert(first && (first->nodes.size() == 2));
+            assert(first->nodes[1].node->toInteger() == 4);
+            assert(second && (second->nodes[0].node->toInteger() == 9));
+            assert(third && third->nodes.empty());
+
+            pfx::Input failing("", "pmap fetch square fetch ( 1 2 unknown 4 )");
+            bool thrown = false;
+            try
+            {
+                ctx.compileCode(failing)->evaluate();
+            }
+            catch (const pfx::Error &)
+            {
+                thrown = true;
+            }
+            assert(thrown);
+
+            ctx.setCommand("square", nullptr);
+        }
+
+        printf("Test 9\n");
+        // plist gives what list gives, in parallel when the elements are pure.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setThreadCount(3);
+            ctx.setCommand("if", std::make_shared<IfCommand>());
+            ctx.setCommand("<", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return int(a < b); }));
+            ctx.setCommand("+", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a + b; }));
+            ctx.setCommand("-", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a - b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            pfx::Input functions("", R"(
+                bind fibo lambda ( n ) ( ) (
+                    if < n 2 ( n ) ( + fibo - n 1 fibo - n 2 )
+                )
+            )");
+            ctx.compileCode(functions)->evaluate();
+            std::string elements;
+            for (int i = 0; i < 40; i++)
+            {
+                elements += " fibo " + std::to_string(i % 15) + " string " +
+                            std::to_string(i);
+            }
+            for (const char *command : {"list", "plist"})
+            {
+                pfx::Input input("", std::string(command) + " (" + elements +
+                                         " )");
+                pfx::GroupRef results =
+                    ctx.compileCode(input)->evaluate()->asGroup();
+                assert(results && (results->nodes.size() == 80));
+                const int fibos[] = {0, 1, 1, 2, 3, 5, 8, 13,
+                                     21, 34, 55, 89, 144, 233, 377};
+                for (int i = 0; i < 40; i++)
+                {
+                    assert(results->nodes[2 * i].node->toInteger() ==
+                           fibos[i % 15]);
+                    assert(results->nodes[2 * i + 1].node->toString() ==
+                           std::to_string(i));
+                }
+            }
+
+            // let changes a variable, so they run in sequence.
+            pfx::Input sequence("", "plist ( let y 1 + y 1 + y 2 )");
+            pfx::GroupRef results =
+                ctx.compileCode(sequence)->evaluate()->asGroup();
+            assert(results && (results->nodes.size() == 3));
+            assert(results->nodes[1].node->toInteger() == 2);
+            assert(results->nodes[2].node->toInteger() == 3);
+
+            ctx.setCommand("fibo", nullptr);
+        }
+
+        printf("Test 10\n");
+        // The bodies read their own parameters and locals, not the ones of
+        // the callers.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setCommand("assert", std::make_shared<AssertCommand>());
+            ctx.setCommand("+", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a + b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            pfx::Input input("", R"(
+                let x 5
+                bind global lambda ( ) ( ) ( x )
+                bind shadow lambda ( x ) ( y ) (
+                    let y + x 1
+                    let x + y 1
+                    + x global
+                )
+                assert shadow 1 8
+                assert x 5
+
+                bind outer lambda ( k ) ( ) (
+                    bind inner lambda ( v ) ( ) ( + k v )
+                    inner 10
+                )
+                assert outer 3 13
+            )");
+            ctx.compileCode(input)->evaluate();
+
+            // The slots of outer are gone with its call.
+            pfx::Input late("", "inner 1");
+            bool thrown = false;
+            try
+            {
+                ctx.compileCode(late)->evaluate();
+            }
+            catch (const pfx::Error &)
+            {
+                thrown = true;
+            }
+            assert(thrown);
+
+            ctx.setCommand("inner", nullptr);
+        }
+
+        printf("Test 11\n");
+        // The recursion goes deeper than the stack of the thread.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            cpfx::applyCommonPfx(ctx);
+            ctx.setCommand("if", std::make_shared<IfCommand>());
+            ctx.setCommand("+", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a + b; }));
+            ctx.setCommand("-", std::make_shared<IntegerCommand>(
+                                    [](int a, int b) { return a - b; }));
+            ctx.setBytecodeCompilation(bytecode);
+
+            pfx::Input define("", R"(
+                bind depth lambda ( n ) ( ) (
+                    if n ( + 1 depth - n 1 ) ( 0 )
+                )
+            )");
+            ctx.compileCode(define)->evaluate();
+            pfx::Input deep("", "depth 20000");
+            pfx::GroupRef code = ctx.compileCode(deep);
+            assert(code->evaluateValue().toInteger() == 20000);
+
+            // The same on the workers of the thread pool.
+            pfx::Input parallel("", "pmap fetch depth fetch ( 1000 20000 )");
+            pfx::GroupRef results =
+                ctx.compileCode(parallel)->evaluate()->asGroup();
+            assert(results->nodes[1].node->toInteger() == 20000);
+
+            // Deeper than the limit.
+            pfx::DepthLimit::set(2000);
+            bool tooDeep = false;
+            try
+            {
+                code->evaluateValue();
+            }
+            catch (const pfx::error::TooDeep &)
+            {
+                tooDeep = true;
+            }
+            pfx::DepthLimit::set(pfx::DepthLimit::defaultLimit);
+            assert(tooDeep);
+            assert(code->evaluateValue().toInteger() == 20000);
+
+            ctx.setCommand("depth", nullptr);
+        }
     }
     catch (const pfx::Error &e)
     {
@@ -3,6 +3,7 @@
 #include <cmath>
 
 #include <cstdio>
+#include <functional>
 #include <memory>
 #include <typeinfo>
 #include <vector>
@@ -13,215 +14,343 @@ template <class... Args> int printF(const char *fmt, Args &&... args)
     return printf(fmt, args...); // NOLINT
 }
 
-struct PrintCommand : pfx::Command
+struct PrintCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    PrintCommand() : FixedCommand({pfx::ArgMode::Evaluate})
     {
-        auto node = iter.evaluateNext();
+    }
 
-        printF("%s", node->toString().c_str());
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &value = args[0];
+
+        printF("%s", value.toString().c_str());
 
         return pfx::NullNode::instance;
     }
 };
 
-struct PrintLnCommand : pfx::Command
+struct PrintLnCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    PrintLnCommand() : FixedCommand({pfx::ArgMode::Evaluate})
     {
-        auto node = iter.evaluateNext();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &value = args[0];
 
-        printF("%s\n", node->toString().c_str());
+        printF("%s\n", value.toString().c_str());
 
         return pfx::NullNode::instance;
     }
 };
 
-struct AddCommand : pfx::Command
+/**
+ * Quickens a binary command for two integers or two floats, the fast paths
+ * skip the type checks of apply().
+ */
+template <class T, class Operation>
+const pfx::Quickening *quickenNumbers(const pfx::Arguments &args)
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    static const pfx::Quickening integers = pfx::Quickening::of<T>(
+        {pfx::NodeType::Integer, pfx::NodeType::Integer},
+        [](const pfx::Arguments &args) {
+            return pfx::Value(
+                Operation()(args[0].toInteger(), args[1].toInteger()));
+        });
+    static const pfx::Quickening floats = pfx::Quickening::of<T>(
+        {pfx::NodeType::FloatingPoint, pfx::NodeType::FloatingPoint},
+        [](const pfx::Arguments &args) {
+            return pfx::Value(
+                Operation()(args[0].toDouble(), args[1].toDouble()));
+        });
+
+    if (args[0].getType() != args[1].getType()) return nullptr;
+    switch (args[0].getType())
+    {
+    case pfx::NodeType::Integer:
+        return &integers;
+    case pfx::NodeType::FloatingPoint:
+        return &floats;
+    default:
+        return nullptr;
+    }
+}
+
+struct AddCommand : pfx::FixedCommand
+{
+    AddCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+    {
+        setTag<AddCommand>();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        auto arg1 = iter.evaluateNext();
-        auto arg2 = iter.evaluateNext();
+        auto &arg1 = args[0];
+        auto &arg2 = args[1];
 
-        if (arg1->getType() != arg2->getType())
+        if (arg1.getType() != arg2.getType())
         {
             return pfx::NullNode::instance;
         }
 
-        switch (arg1->getType())
+        switch (arg1.getType())
         {
         case pfx::NodeType::Integer:
-            return pfx::createInteger(arg1->toInteger() + arg2->toInteger());
+            return pfx::Value(arg1.toInteger() + arg2.toInteger());
         case pfx::NodeType::FloatingPoint:
-            return pfx::createFloat(arg1->toDouble() + arg2->toDouble());
+            return pfx::Value(arg1.toDouble() + arg2.toDouble());
         default:
-            return pfx::createString(arg1->toString() + arg2->toString());
+            return pfx::createString(arg1.toString() + arg2.toString());
         }
     }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenNumbers<AddCommand, std::plus<>>(args);
+    }
 };
 
-struct SubCommand : pfx::Command
+struct SubCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    SubCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
     {
-        auto arg1 = iter.evaluateNext();
-        auto arg2 = iter.evaluateNext();
+        setTag<SubCommand>();
+        setPure();
+    }
 
-        if (arg1->getType() != arg2->getType())
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &arg1 = args[0];
+        auto &arg2 = args[1];
+
+        if (arg1.getType() != arg2.getType())
         {
             return pfx::NullNode::instance;
         }
 
-        switch (arg1->getType())
+        switch (arg1.getType())
         {
         case pfx::NodeType::Integer:
-            return pfx::createInteger(arg1->toInteger() - arg2->toInteger());
+            return pfx::Value(arg1.toInteger() - arg2.toInteger());
         case pfx::NodeType::FloatingPoint:
-            return pfx::createFloat(arg1->toDouble() - arg2->toDouble());
+            return pfx::Value(arg1.toDouble() - arg2.toDouble());
         default:
             return pfx::NullNode::instance;
         }
     }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenNumbers<SubCommand, std::minus<>>(args);
+    }
 };
 
-struct MultiplyCommand : pfx::Command
+struct MultiplyCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    MultiplyCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+    {
+        setTag<MultiplyCommand>();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        auto arg1 = iter.evaluateNext();
-        auto arg2 = iter.evaluateNext();
+        auto &arg1 = args[0];
+        auto &arg2 = args[1];
 
-        if (arg1->getType() != arg2->getType())
+        if (arg1.getType() != arg2.getType())
         {
             return pfx::NullNode::instance;
         }
 
-        switch (arg1->getType())
+        switch (arg1.getType())
         {
         case pfx::NodeType::Integer:
-            return pfx::createInteger(arg1->toInteger() * arg2->toInteger());
+            return pfx::Value(arg1.toInteger() * arg2.toInteger());
         case pfx::NodeType::FloatingPoint:
-            return pfx::createFloat(arg1->toDouble() * arg2->toDouble());
+            return pfx::Value(arg1.toDouble() * arg2.toDouble());
         default:
             return pfx::NullNode::instance;
         }
     }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenNumbers<MultiplyCommand, std::multiplies<>>(args);
+    }
 };
 
-struct DivideCommand : pfx::Command
+struct DivideCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    DivideCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
     {
-        auto arg1 = iter.evaluateNext();
-        auto arg2 = iter.evaluateNext();
+        setTag<DivideCommand>();
+        setPure();
+    }
 
-        if (arg1->getType() != arg2->getType())
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &arg1 = args[0];
+        auto &arg2 = args[1];
+
+        if (arg1.getType() != arg2.getType())
         {
             return pfx::NullNode::instance;
         }
 
-        switch (arg1->getType())
+        switch (arg1.getType())
         {
         case pfx::NodeType::Integer:
-            return pfx::createInteger(arg1->toInteger() / arg2->toInteger());
+            return pfx::Value(arg1.toInteger() / arg2.toInteger());
         case pfx::NodeType::FloatingPoint:
-            return pfx::createFloat(arg1->toDouble() / arg2->toDouble());
+            return pfx::Value(arg1.toDouble() / arg2.toDouble());
         default:
             return pfx::NullNode::instance;
         }
     }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenNumbers<DivideCommand, std::divides<>>(args);
+    }
 };
 
-struct LessCommand : pfx::Command
+struct LessCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    LessCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
     {
-        auto arg1 = iter.evaluateNext();
-        auto arg2 = iter.evaluateNext();
+        setTag<LessCommand>();
+        setPure();
+    }
 
-        if (arg1->getType() != arg2->getType())
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &arg1 = args[0];
+        auto &arg2 = args[1];
+
+        if (arg1.getType() != arg2.getType())
         {
             return pfx::NullNode::instance;
         }
 
-        switch (arg1->getType())
+        switch (arg1.getType())
         {
         case pfx::NodeType::Integer:
-            return pfx::createInteger(arg1->toInteger() < arg2->toInteger());
+            return pfx::Value(arg1.toInteger() < arg2.toInteger());
         case pfx::NodeType::FloatingPoint:
-            return pfx::createInteger(arg1->toDouble() < arg2->toDouble());
+            return pfx::Value(arg1.toDouble() < arg2.toDouble());
         case pfx::NodeType::String:
-            return pfx::createInteger(arg1->toString() < arg2->toString());
+            return pfx::Value(arg1.toString() < arg2.toString());
         default:
             return pfx::NullNode::instance;
         }
     }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenNumbers<LessCommand, std::less<>>(args);
+    }
 };
 
-struct EqualCommand : pfx::Command
+struct EqualCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    EqualCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+    {
+        setTag<EqualCommand>();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
     {
-        auto arg1 = iter.evaluateNext();
-        auto arg2 = iter.evaluateNext();
+        auto &arg1 = args[0];
+        auto &arg2 = args[1];
 
-        if (arg1->getType() != arg2->getType())
+        if (arg1.getType() != arg2.getType())
         {
             return pfx::NullNode::instance;
         }
 
-        switch (arg1->getType())
+        switch (arg1.getType())
         {
         case pfx::NodeType::Integer:
-            return pfx::createInteger(arg1->toInteger() == arg2->toInteger());
+            return pfx::Value(arg1.toInteger() == arg2.toInteger());
         case pfx::NodeType::FloatingPoint:
-            return pfx::createInteger(arg1->toDouble() == arg2->toDouble());
+            return pfx::Value(arg1.toDouble() == arg2.toDouble());
         case pfx::NodeType::String:
-            return pfx::createInteger(arg1->toString() == arg2->toString());
+            return pfx::Value(arg1.toString() == arg2.toString());
         default:
             return pfx::NullNode::instance;
         }
     }
+
+    const pfx::Quickening *quicken(const pfx::Arguments &args) const override
+    {
+        return quickenNumbers<EqualCommand, std::equal_to<>>(args);
+    }
 };
 
-struct SqrtCommand : pfx::Command
+struct SqrtCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    SqrtCommand() : FixedCommand({pfx::ArgMode::Evaluate})
     {
-        auto arg = iter.evaluateNext();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &arg = args[0];
 
-        return pfx::createFloat(sqrt(arg->toDouble()));
+        return pfx::Value(sqrt(arg.toDouble()));
     }
 };
 
-struct WhileCommand : pfx::Command
+struct WhileCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    WhileCommand() : FixedCommand({pfx::ArgMode::Fetch, pfx::ArgMode::Fetch})
     {
-        auto conditionNode = iter.fetchNext();
-        auto statementNode = iter.fetchNext();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto conditionNode = args[0].toNode();
+        auto statementNode = args[1].toNode();
 
-        while (conditionNode->evaluate()->toInteger())
+        while (conditionNode->evaluateValue().toInteger())
         {
-            statementNode->evaluate();
+            statementNode->evaluateValue();
         }
 
         return pfx::NullNode::instance;
     }
 };
 
-struct IfCommand : pfx::Command
+struct IfCommand : pfx::FixedCommand
 {
-    pfx::NodeRef execute(pfx::ArgIterator &iter) override
+    IfCommand()
+        : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Fetch, pfx::ArgMode::Fetch})
     {
-        auto cond = iter.evaluateNext();
-        auto thenPart = iter.fetchNext();
-        auto elsePart = iter.fetchNext();
+        setPure();
+    }
+
+    pfx::Value apply(const pfx::Arguments &args) override
+    {
+        auto &cond = args[0];
+        auto thenPart = args[1].toNode();
+        auto elsePart = args[2].toNode();
 
-        auto &thePart = cond->toInteger() ? thenPart : elsePart;
+        auto &thePart = cond.toInteger() ? thenPart : elsePart;
 
-        return thePart->evaluate();
+        return thePart->evaluateValue();
     }
 };
 
@@ -298,7 +427,7 @@ struct CommentCommand : pfx::Command
 {
     pfx::NodeRef execute(pfx::ArgIterator &iter) override
     {
-        iter.fetchNext();
+        iter.fetchNextNode();
 
         return pfx::NullNode::instance;
     }
@@ -357,6 +486,9 @@ int main()
 
         cpfx::applyCommonPfx(ctx);
 
+        // The compiled code runs on the bytecode engine.
+        ctx.setBytecodeCompilation(true);
+
         ctx.setCommand("print", std::make_shared<PrintCommand>());
         ctx.setCommand("println", std::make_shared<PrintLnCommand>());
         ctx.setCommand("dump", std::make_shared<DumpCommand>());
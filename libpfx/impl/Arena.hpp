@@ -0,0 +1,68 @@
+/// @file Arena.hpp Contains the Arena class and its allocator.
+
+namespace pfx
+{
+/**
+ * Bump allocator for the nodes of a compiled program.
+ *
+ * @remarks
+ * Deallocation does nothing, all memory is freed at once when the arena is
+ * destroyed. The arena is reference counted, each node allocated from it holds
+ * a reference, so it lives as long as any of the nodes do. Allocation is not
+ * thread safe, it's meant to be used during compilation only.
+ */
+class Arena : public std::pmr::memory_resource
+{
+    std::pmr::monotonic_buffer_resource buffer;
+    size_t used = 0;
+    RefCounter refCount;
+
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        used += bytes;
+        return buffer.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *, size_t, size_t) override
+    {
+        // Freed when the arena is destroyed.
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const
+        noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    /// Creates an empty arena.
+    Arena() : buffer(64 * 1024)
+    {
+    }
+
+    /// @return The number of bytes allocated from the arena.
+    size_t getUsed() const
+    {
+        return used;
+    }
+
+    /// Adds a reference.
+    void addRef()
+    {
+        refCount.increment();
+    }
+
+    /// Removes a reference, the last one deletes the arena.
+    void release()
+    {
+        if (refCount.decrement()) delete this;
+    }
+
+    /// @return The number of references.
+    int getRefCount() const
+    {
+        return refCount.get();
+    }
+};
+
+} // namespace pfx
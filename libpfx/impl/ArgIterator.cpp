@@ -1,19 +1,82 @@
 namespace pfx
 {
+/// Sets the site of the iterator while a node is evaluated.
+class SiteScope
+{
+    ArgIterator &iterator;
+    const CacheSlot *outer;
+
+public:
+    SiteScope(ArgIterator &iterator, const CacheSlot *cache)
+        : iterator(iterator), outer(iterator.cache)
+    {
+        iterator.cache = cache;
+    }
+
+    ~SiteScope()
+    {
+        iterator.cache = outer;
+    }
+
+    SiteScope(const SiteScope &) = delete;
+    SiteScope &operator=(const SiteScope &) = delete;
+};
+
 NodeRef ArgIterator::fetchNext()
 {
     if (current == end)
     {
         return NullNode::instance;
     }
-    NodeInfo tmp = *current;
+    const NodeRef &node = current->node;
+    current++;
+    return node;
+}
+
+const Node &ArgIterator::fetchNextNode()
+{
+    if (current == end)
+    {
+        return *NullNode::instance;
+    }
+    const Node &node = *current->node;
     current++;
-    return tmp.node;
+    return node;
 }
 
 NodeRef ArgIterator::evaluateNext()
 {
-    return fetchNext()->evaluate(*this);
+    if (current == end)
+    {
+        return NullNode::instance;
+    }
+    // The group owns the node while it's evaluated, no need to hold it.
+    const NodeInfo &info = *current;
+    current++;
+    // Nothing is evaluated while a tail call unwinds.
+    if (TailCall::pending())
+    {
+        return NullNode::instance;
+    }
+    SiteScope scope(*this, &info.cache);
+    return info.node->evaluate(*this);
+}
+
+Value ArgIterator::evaluateNextValue()
+{
+    if (current == end)
+    {
+        return Value();
+    }
+    // The group owns the node while it's evaluated, no need to hold it.
+    const NodeInfo &info = *current;
+    current++;
+    if (TailCall::pending())
+    {
+        return Value();
+    }
+    SiteScope scope(*this, &info.cache);
+    return info.node->evaluateValue(*this);
 }
 
 ArgIterator::IteratorType ArgIterator::dummy;
@@ -36,4 +99,13 @@ NodeRef ArgIterator::next()
     return current->node;
 }
 
+const Node &ArgIterator::nextNode()
+{
+    if (current == end)
+    {
+        return *NullNode::instance;
+    }
+    return *current->node;
+}
+
 } // namespace pfx
\ No newline at end of file
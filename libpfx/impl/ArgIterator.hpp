@@ -9,14 +9,23 @@ struct NodeInfo;
 /// This class is used to iterate on the command node's arguments.
 class ArgIterator
 {
+    // Continues from where the commands leave the iterator.
+    friend class Bytecode;
+
+    // Sets the site of the node being evaluated.
+    friend class SiteScope;
+
 private:
-    typedef std::vector<NodeInfo>::const_iterator IteratorType;
+    typedef std::pmr::vector<NodeInfo>::const_iterator IteratorType;
 
     static IteratorType dummy;
 
     IteratorType current;
     IteratorType end;
 
+    // The cache of the node being evaluated.
+    const CacheSlot *cache = nullptr;
+
 public:
     /**
      * Default constructor creates a dummy iterator. That's immediately on the
@@ -37,6 +46,42 @@ public:
     {
     }
 
+    /**
+     * Sets up an iterator for a node that is evaluated from a known place.
+     *
+     * @param [in] current The iterator the element where the iteration start.
+     * @param [in] end The iterator the points one after the last element.
+     * @param [in] cache The cache of the place.
+     */
+    ArgIterator(IteratorType current, IteratorType end, const CacheSlot *cache)
+        : current(current), end(end), cache(cache)
+    {
+    }
+
+    /**
+     * Creates a dummy iterator for a node that is evaluated from a known
+     * place.
+     *
+     * @param [in] cache The cache of the place.
+     */
+    explicit ArgIterator(const CacheSlot *cache)
+        : current(dummy), end(dummy), cache(cache)
+    {
+    }
+
+    /**
+     * @return The cache of the call site of the node being evaluated, nullptr
+     * if it's not evaluated from a site, like through the dummy iterator.
+     *
+     * @remarks
+     *  While a command reads its arguments, they are evaluated from their own
+     * sites. The command gets its own site back when they return.
+     */
+    const CacheSlot *getCache() const
+    {
+        return cache;
+    }
+
     /**
      * @return The position of the current node. If the iterator is finished, it
      * returns a default Position() object.
@@ -61,6 +106,18 @@ public:
      */
     NodeRef evaluateNext();
 
+    /**
+     * Evaluates the next node, producing a value.
+     *
+     * @return The result of the evaluation, null if the iterator is at the
+     * end.
+     *
+     * @remarks
+     *  Works like evaluateNext(), but integer and float results are not
+     * allocated as nodes.
+     */
+    Value evaluateNextValue();
+
     /**
      * Reads the next node then moves the iterator forward.
      *
@@ -73,6 +130,24 @@ public:
      */
     NodeRef fetchNext();
 
+    /**
+     * Reads the next node without taking a reference, then moves the iterator
+     * forward.
+     *
+     * @return The next node, the NullNode if the iterator is at the end.
+     *
+     * @remarks
+     *  The node belongs to the group being iterated, so it stays valid while
+     * the command reading it runs. Take a NodeRef only to keep it longer.
+     */
+    const Node &fetchNextNode();
+
+    /**
+     * @return The next node without taking a reference, like fetchNextNode(),
+     * but the iterator doesn't move.
+     */
+    const Node &nextNode();
+
     /**
      * @return True if the iterator is reached the the end, false otherwise.
      */
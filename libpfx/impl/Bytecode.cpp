@@ -0,0 +1,406 @@
+namespace pfx
+{
+/// A command in the dispatch loop that waits for its arguments.
+struct PendingCall
+{
+    Command *command;
+    CallSite *site;
+    const CacheSlot *cache;
+    const std::vector<ArgMode> *modes;
+    size_t next;       // The index of the next argument.
+    size_t base;       // Where the arguments start on the value stack.
+    Position position; // Where the next evaluated argument starts.
+};
+
+/**
+ * A stack that keeps its first elements inline.
+ *
+ * @remarks
+ *  Only the used elements are constructed, so an empty stack is cheap to set
+ * up. It moves its elements when it grows.
+ */
+template <class T, size_t inlineCount>
+class InlineStack
+{
+    alignas(T) unsigned char buffer[inlineCount * sizeof(T)];
+    std::unique_ptr<unsigned char[]> heap;
+    T *items = reinterpret_cast<T *>(buffer);
+    size_t count = 0;
+    size_t capacity = inlineCount;
+
+    void grow()
+    {
+        std::unique_ptr<unsigned char[]> bigger(
+            new unsigned char[capacity * 2 * sizeof(T)]);
+        T *moved = reinterpret_cast<T *>(bigger.get());
+        for (size_t i = 0; i < count; i++)
+        {
+            new (moved + i) T(std::move(items[i]));
+            items[i].~T();
+        }
+        heap = std::move(bigger);
+        items = moved;
+        capacity *= 2;
+    }
+
+public:
+    InlineStack()
+    {
+    }
+
+    ~InlineStack()
+    {
+        resize(0);
+    }
+
+    InlineStack(const InlineStack &) = delete;
+    InlineStack &operator=(const InlineStack &) = delete;
+
+    /// @return The number of elements.
+    size_t size() const
+    {
+        return count;
+    }
+
+    /// @return True if there are no elements.
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    /// @return The first element.
+    T *data()
+    {
+        return items;
+    }
+
+    /// @return The top element.
+    T &back()
+    {
+        return items[count - 1];
+    }
+
+    /**
+     * @param [in] index The index of the element.
+     *
+     * @return The element.
+     */
+    T &operator[](size_t index)
+    {
+        return items[index];
+    }
+
+    /**
+     * Pushes an element.
+     *
+     * @param [in] item The element.
+     */
+    void push_back(T item)
+    {
+        if (count == capacity) grow();
+        new (items + count) T(std::move(item));
+        count++;
+    }
+
+    /**
+     * Constructs an element on the top.
+     *
+     * @param [in] args The arguments of the constructor.
+     */
+    template <class... Args>
+    void emplace_back(Args &&... args)
+    {
+        if (count == capacity) grow();
+        new (items + count) T(std::forward<Args>(args)...);
+        count++;
+    }
+
+    /// Removes the top element.
+    void pop_back()
+    {
+        items[--count].~T();
+    }
+
+    /**
+     * Removes the elements above the given size.
+     *
+     * @param [in] newSize The new size, not larger than the current one.
+     */
+    void resize(size_t newSize)
+    {
+        while (count > newSize)
+        {
+            pop_back();
+        }
+    }
+};
+
+/// An outer group in the dispatch loop that waits for its child group.
+struct GroupFrame
+{
+    const Bytecode *bytecode;
+    const std::pmr::vector<NodeInfo> *nodes;
+    size_t pc;
+    size_t callBase; // Where the waiting calls of the group start.
+};
+
+/**
+ * The stacks of a single run of the dispatch loop.
+ *
+ * @remarks
+ *  Each run has its own stacks, so the arguments can be passed to a command
+ * where they are. The nested runs can't move them.
+ */
+struct DispatchStacks
+{
+    InlineStack<Value, 16> values;
+    InlineStack<Position, 16> positions; // The positions of the values.
+    InlineStack<PendingCall, 8> calls;
+    InlineStack<GroupFrame, 4> groups;
+};
+
+/// Pops the innermost call and runs its command with the collected arguments.
+static Value completeCall(DispatchStacks &stacks)
+{
+    PendingCall &call = stacks.calls.back();
+    size_t base = call.base;
+    Command *command = call.command;
+    CallSite *site = call.site;
+    const CacheSlot *cache = call.cache;
+    stacks.calls.pop_back();
+
+    Value result = site->call(
+        *command,
+        Arguments(stacks.values.data() + base, stacks.positions.data() + base,
+                  stacks.values.size() - base, cache));
+    stacks.values.resize(base);
+    stacks.positions.resize(base);
+    return result;
+}
+
+Bytecode::Bytecode(const GroupNode &group)
+    : code(group.nodes.size()) // The call sites can't be moved.
+{
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        Instruction &instruction = code[i];
+        const NodeRef &child = group.nodes[i].node;
+        const Node *node = child.get();
+        instruction.source = node;
+        // The tags are checked, other classes may report any type.
+        if (auto *integer = node->as<IntegerNode>())
+        {
+            instruction.op = Op::Push;
+            instruction.value = Value(integer->value);
+        }
+        else if (auto *floating = node->as<FloatNode>())
+        {
+            instruction.op = Op::Push;
+            instruction.value = Value(floating->value);
+        }
+        else if (node->as<StringNode>() || node->as<NullNode>())
+        {
+            instruction.op = Op::Push;
+            instruction.value = Value(child);
+        }
+        else if (node->as<GroupNode>())
+        {
+            instruction.op = Op::Group;
+        }
+        else if (node->as<CommandNode>())
+        {
+            instruction.op = Op::Call;
+        }
+        else
+        {
+            instruction.op = Op::Eval;
+        }
+    }
+}
+
+
+bool Bytecode::matches(const GroupNode &group) const
+{
+    if (code.size() != group.nodes.size()) return false;
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        if (code[i].source != group.nodes[i].node.get()) return false;
+    }
+    return true;
+}
+
+
+Value Bytecode::run(const GroupNode &group) const
+{
+    Position start = group.nodes.empty() ? Position() : group.nodes[0].start;
+    if (DepthLimit::stackFull())
+    {
+        return DepthLimit::onNewStack(start, [&] { return run(group); });
+    }
+    DepthLimit::Guard guard(start);
+    DispatchStacks stacks;
+    // The group running now, the outer ones wait on the group stack.
+    const Bytecode *bytecode = this;
+    const std::pmr::vector<NodeInfo> *nodes = &group.nodes;
+    size_t n = code.size();
+    size_t pc = 0;
+    size_t callBase = 0;
+    Value result;
+
+    for (;;)
+    {
+        Value value;
+        bool produced = true;
+
+        if (pc < n)
+        {
+            const Instruction &instruction = bytecode->code[pc];
+            const NodeInfo &info = (*nodes)[pc];
+            const Node *node = info.node.get();
+            pc++;
+
+            switch (instruction.op)
+            {
+            case Op::Push:
+                value = instruction.value;
+                break;
+            case Op::Group:
+            {
+                // Continue in the compiled groups, the rest are evaluated.
+                auto *child = static_cast<const GroupNode *>(node);
+                const Bytecode *code = child->bytecode.get();
+                if (code && code->matches(*child))
+                {
+                    stacks.groups.push_back(
+                        GroupFrame{bytecode, nodes, pc, callBase});
+                    bytecode = code;
+                    nodes = &child->nodes;
+                    n = code->size();
+                    pc = 0;
+                    callBase = stacks.calls.size();
+                    result = Value();
+                    continue;
+                }
+                value = child->evaluateValue();
+                break;
+            }
+            case Op::Call:
+            {
+                const Binding &binding =
+                    static_cast<const CommandNode *>(node)->getBinding();
+                Command *command = binding.command.get();
+                if (!command)
+                {
+                    // A variable.
+                    value = binding.value;
+                    break;
+                }
+                const Signature *signature = command->getSignature();
+                if (!signature)
+                {
+                    // Opaque command, it reads its arguments itself.
+                    ArgIterator iterator(nodes->begin() + pc, nodes->end(),
+                                         &info.cache);
+                    value = command->call(iterator);
+                    pc = iterator.current - nodes->begin();
+                }
+                else if (signature->args.empty())
+                {
+                    value = instruction.site.call(
+                        *command, Arguments(nullptr, nullptr, 0, &info.cache));
+                }
+                else
+                {
+                    stacks.calls.push_back(PendingCall{
+                        command, &instruction.site, &info.cache,
+                        &signature->args, 0, stacks.values.size(),
+                        Position()});
+                    produced = false;
+                }
+                break;
+            }
+            case Op::Eval:
+            {
+                ArgIterator iterator(nodes->begin() + pc, nodes->end(),
+                                     &info.cache);
+                value = node->evaluateValue(iterator);
+                pc = iterator.current - nodes->begin();
+                break;
+            }
+            }
+
+            // A tail call was requested, the waiting calls are dropped.
+            if (TailCall::pending()) return Value();
+        }
+        else if (stacks.calls.size() == callBase)
+        {
+            // The group ended, its result goes to the outer group.
+            if (stacks.groups.empty()) return result;
+
+            GroupFrame &frame = stacks.groups.back();
+            bytecode = frame.bytecode;
+            nodes = frame.nodes;
+            n = bytecode->size();
+            pc = frame.pc;
+            callBase = frame.callBase;
+            stacks.groups.pop_back();
+            value = std::move(result);
+        }
+        // Otherwise the group ended with calls still waiting, their missing
+        // arguments are null.
+
+        // Pass the value to the waiting calls of the group. Fetch the
+        // arguments that are not evaluated and run the calls that have all of
+        // their arguments.
+        for (;;)
+        {
+            if (stacks.calls.size() == callBase)
+            {
+                result = std::move(value);
+                break;
+            }
+
+            PendingCall &call = stacks.calls.back();
+            if (produced)
+            {
+                stacks.values.push_back(std::move(value));
+                stacks.positions.push_back(call.position);
+                call.next++;
+                produced = false;
+            }
+
+            const std::vector<ArgMode> &modes = *call.modes;
+            while ((call.next < modes.size()) &&
+                   (modes[call.next] == ArgMode::Fetch))
+            {
+                if (pc < n)
+                {
+                    // The group owns the node while the command runs.
+                    stacks.values.emplace_back(*(*nodes)[pc].node,
+                                               Value::Borrow());
+                    stacks.positions.push_back((*nodes)[pc].start);
+                    pc++;
+                }
+                else
+                {
+                    stacks.values.emplace_back(*NullNode::instance,
+                                               Value::Borrow());
+                    stacks.positions.push_back(Position());
+                }
+                call.next++;
+            }
+
+            if (call.next < modes.size())
+            {
+                // The next argument is evaluated by the loop.
+                call.position = pc < n ? (*nodes)[pc].start : Position();
+                break;
+            }
+
+            value = completeCall(stacks);
+            if (TailCall::pending()) return Value();
+            produced = true;
+        }
+    }
+}
+} // namespace pfx
@@ -0,0 +1,75 @@
+/// @file Bytecode.hpp Contains the Bytecode class.
+
+namespace pfx
+{
+/**
+ * The children of a group lowered to instructions for a dispatch loop.
+ *
+ * @remarks
+ * There is one instruction for each child, so the program counter is also the
+ * index of the child it belongs to. Literals are pushed as precomputed values.
+ * Commands that have a signature are called directly: the loop reads their
+ * arguments onto a value stack then calls Command::apply(), without recursion
+ * for the nested calls. Other commands get an ArgIterator positioned after them
+ * and the loop continues wherever they leave it. Each call instruction is a
+ * CallSite, so it takes the fast path the command offers for its arguments.
+ *
+ * The instructions are a snapshot of the children. Each instruction keeps the
+ * child it was compiled from, so matches() notices when a child is replaced
+ * and the group falls back to evaluating its nodes until it's compiled again.
+ */
+class Bytecode
+{
+    /// The operation of an instruction.
+    enum class Op : uint8_t
+    {
+        Push,  ///< Pushes the value of a literal.
+        Group, ///< Evaluates a child group.
+        Call,  ///< Calls the command of a command node.
+        Eval   ///< Evaluates any other node through an iterator.
+    };
+
+    /// A single instruction.
+    struct Instruction
+    {
+        Op op = Op::Eval;
+        const Node *source;    ///< The child it was compiled from.
+        Value value;           ///< The value of the literal for Push.
+        mutable CallSite site; ///< The fast path of the command for Call.
+    };
+
+    std::vector<Instruction> code;
+
+public:
+    /**
+     * Compiles the children of the group.
+     *
+     * @param [in] group The group to compile.
+     */
+    explicit Bytecode(const GroupNode &group);
+
+    /// @return The number of instructions, the same as the number of children.
+    size_t size() const
+    {
+        return code.size();
+    }
+
+    /**
+     * Checks that the children are the ones the code was compiled from.
+     *
+     * @param [in] group The group the code was compiled from.
+     *
+     * @return True if the code can still run the children of the group.
+     */
+    bool matches(const GroupNode &group) const;
+
+    /**
+     * Runs the code.
+     *
+     * @param [in] group The group the code was compiled from.
+     *
+     * @return The value of the last evaluation, like GroupNode::evaluate().
+     */
+    Value run(const GroupNode &group) const;
+};
+} // namespace pfx
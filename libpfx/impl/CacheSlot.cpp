@@ -0,0 +1,26 @@
+namespace pfx
+{
+CacheSlot &CacheSlot::operator=(const CacheSlot &other)
+{
+    // The slot belongs to another node now.
+    if (this != &other) clear();
+    return *this;
+}
+
+
+CacheSlot &CacheSlot::operator=(CacheSlot &&other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        entry.store(other.entry.exchange(nullptr));
+    }
+    return *this;
+}
+
+
+void CacheSlot::clear()
+{
+    delete entry.exchange(nullptr);
+}
+} // namespace pfx
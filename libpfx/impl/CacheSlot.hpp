@@ -0,0 +1,131 @@
+/// @file CacheSlot.hpp Contains the CacheSlot class.
+
+namespace pfx
+{
+/**
+ * An opaque cache of a call site, the commands keep the results of their setup
+ * work in it.
+ *
+ * @remarks
+ *  Each NodeInfo has one, so there is one for each place a command is called
+ * from. The command reaches it through ArgIterator::getCache() or
+ * Arguments::getCache() and stores a single object of any type in it. The
+ * object lives as long as the compiled program.
+ *
+ * The object is created on first use and never modified, the threads
+ * evaluating the same program may share it. When a different type is asked
+ * for (the command was rebound), the new object replaces the old one, but the
+ * old one is kept until the slot is destroyed, since a running command may
+ * still use it.
+ *
+ * A copied slot is empty, the copy is another site.
+ */
+class CacheSlot
+{
+    // A cached object, owns the ones it replaced.
+    struct Entry
+    {
+        const void *tag;
+        Entry *replaced = nullptr;
+
+        explicit Entry(const void *tag) : tag(tag)
+        {
+        }
+
+        virtual ~Entry()
+        {
+            delete replaced;
+        }
+    };
+
+    template <class T>
+    struct Holder : Entry
+    {
+        const T value;
+
+        template <class Make>
+        explicit Holder(Make &make) : Entry(tagOf<T>()), value(make())
+        {
+        }
+    };
+
+    // The address of a variable that is unique to each type.
+    template <class T>
+    static const void *tagOf()
+    {
+        static const char unique = 0;
+        return &unique;
+    }
+
+    mutable std::atomic<Entry *> entry{nullptr};
+
+public:
+    CacheSlot()
+    {
+    }
+
+    CacheSlot(const CacheSlot &)
+    {
+    }
+
+    CacheSlot(CacheSlot &&other) noexcept : entry(other.entry.exchange(nullptr))
+    {
+    }
+
+    CacheSlot &operator=(const CacheSlot &other);
+
+    CacheSlot &operator=(CacheSlot &&other) noexcept;
+
+    ~CacheSlot()
+    {
+        clear();
+    }
+
+    /**
+     * Gets the cached object, creates it on first use.
+     *
+     * @param [in] make Creates the object, it's called with no arguments and
+     * returns a T.
+     *
+     * @return The cached object.
+     *
+     * @remarks
+     *  When threads create the object at the same time, one of them is kept
+     * and the others are dropped.
+     */
+    template <class T, class Make>
+    const T &get(Make make) const
+    {
+        Entry *current = entry.load(std::memory_order_acquire);
+        if (current && (current->tag == tagOf<T>()))
+        {
+            return static_cast<Holder<T> *>(current)->value;
+        }
+
+        std::unique_ptr<Holder<T>> made(new Holder<T>(make));
+        for (;;)
+        {
+            made->replaced = current;
+            if (entry.compare_exchange_weak(current, made.get(),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+            {
+                return made.release()->value;
+            }
+            if (current && (current->tag == tagOf<T>()))
+            {
+                made->replaced = nullptr;
+                return static_cast<Holder<T> *>(current)->value;
+            }
+        }
+    }
+
+    /**
+     * Destroys the cached objects.
+     *
+     * @remarks
+     *  Nothing may use the slot meanwhile.
+     */
+    void clear();
+};
+} // namespace pfx
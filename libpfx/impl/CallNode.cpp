@@ -0,0 +1,57 @@
+namespace pfx
+{
+void CallNode::dump(int indent) const
+{
+    printf("Call: %s (\n", target->prettyName.c_str());
+    for (const NodeInfo &arg : args)
+    {
+        dumpIndent(indent + 1);
+        arg.node->dump(indent + 1);
+        printf("\n");
+    }
+    dumpIndent(indent);
+    printf(")");
+}
+
+
+NodeRef CallNode::evaluate(ArgIterator &iterator) const
+{
+    return evaluateValue(iterator).toNode();
+}
+
+
+Value CallNode::evaluateValue(ArgIterator &iterator) const
+{
+    const Binding &binding = target->getBinding();
+    Command *command = binding.command.get();
+    if (!command && modes.empty())
+    {
+        // It became a variable, which reads no arguments either.
+        return binding.value;
+    }
+    const Signature *signature = command ? command->getSignature() : nullptr;
+    if (!signature || (signature->args != modes))
+    {
+        position.raiseErrorHere(
+            "The arguments of this command changed since it was compiled.");
+    }
+
+    ArgumentStorage storage(args.size());
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const NodeInfo &arg = args[i];
+        if (modes[i] == ArgMode::Fetch)
+        {
+            storage.borrow(*arg.node, arg.start);
+        }
+        else
+        {
+            // The argument is evaluated from its own site.
+            ArgIterator site(&arg.cache);
+            storage.push(arg.node->evaluateValue(site), arg.start);
+            if (TailCall::pending()) return Value();
+        }
+    }
+    return site.call(*command, storage.getArguments(iterator.getCache()));
+}
+} // namespace pfx
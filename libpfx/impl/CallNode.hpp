@@ -0,0 +1,102 @@
+/// @file CallNode.hpp Contains the CallNode class.
+
+namespace pfx
+{
+/**
+ * A command call with its arguments linked to it during the compilation.
+ *
+ * @remarks
+ *  The compiler creates these for commands that have a signature when
+ * Context::setCallLinking() is enabled. The argument nodes are held directly,
+ * so evaluating the call doesn't need an iterator to find them.
+ *
+ * The command is still taken from the command node on each call, so it can be
+ * rebound. But it must keep the signature the call was linked with, otherwise
+ * the call raises an error. The call is a CallSite, so it takes the fast path
+ * the command offers for the types of its arguments.
+ */
+struct CallNode : Node
+{
+    using Node::evaluate;
+    using Node::evaluateValue;
+
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::Call;
+
+    /// The command node called.
+    const CommandRef target;
+
+    /// How the arguments were linked, the signature of the command then.
+    const std::vector<ArgMode> modes;
+
+    /// The argument nodes, one for each mode.
+    std::pmr::vector<NodeInfo> args;
+
+    /// Where the call starts, for reporting the errors.
+    const Position position;
+
+    /// Keeps the fast path of the command for the linked arguments.
+    mutable CallSite site;
+
+    /**
+     * Creates the call.
+     *
+     * @param [in] target The command node called.
+     * @param [in] modes The signature of the command.
+     * @param [in] position Where the call starts.
+     * @param [in] resource The memory the argument list is allocated from.
+     */
+    CallNode(CommandRef target, std::vector<ArgMode> modes, Position position,
+             std::pmr::memory_resource *resource)
+        : Node(type), target(std::move(target)), modes(std::move(modes)),
+          args(resource), position(position)
+    {
+    }
+
+    /// @return The name of the command.
+    std::string toString() const override
+    {
+        return target->prettyName;
+    }
+
+    /// @return 0
+    int toInteger() const override
+    {
+        return 0;
+    }
+
+    /// @return 0.0
+    double toDouble() const override
+    {
+        return 0.0;
+    }
+
+    void dump(int indent) const override;
+
+    /**
+     * Calls the command with the linked arguments.
+     *
+     * @return The result of the command.
+     *
+     * @throw error::RuntimeError When the signature of the command changed
+     * since the call was linked.
+     */
+    NodeRef evaluate(ArgIterator &) const override;
+
+    /**
+     * Calls the command with the linked arguments, producing a value.
+     *
+     * @return The result of the command.
+     *
+     * @throw error::RuntimeError When the signature of the command changed
+     * since the call was linked.
+     */
+    Value evaluateValue(ArgIterator &) const override;
+
+    /// @return NodeType::Call
+    NodeType getType() const override
+    {
+        return NodeType::Call;
+    }
+};
+} // namespace pfx
@@ -0,0 +1,32 @@
+namespace pfx
+{
+const Quickening CallSite::generic{nullptr, {}, nullptr};
+
+
+Value CallSite::call(Command &command, const Arguments &args)
+{
+    const Quickening *current = quickening.load(std::memory_order_relaxed);
+    if (current)
+    {
+        if (command.owns(*current) && current->accepts(args))
+        {
+            return current->apply(args);
+        }
+        if (current != &generic)
+        {
+            quickening.store(&generic, std::memory_order_relaxed);
+        }
+        return command.apply(args);
+    }
+
+    // The first call, the fast path is taken right away if there is one.
+    const Quickening *offered = command.quicken(args);
+    if (offered && command.owns(*offered) && offered->accepts(args))
+    {
+        quickening.store(offered, std::memory_order_relaxed);
+        return offered->apply(args);
+    }
+    quickening.store(&generic, std::memory_order_relaxed);
+    return command.apply(args);
+}
+} // namespace pfx
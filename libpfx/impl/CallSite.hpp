@@ -0,0 +1,52 @@
+/// @file CallSite.hpp Contains the CallSite class.
+
+namespace pfx
+{
+/**
+ * The place of a command call in the program, it remembers the fast path of
+ * the command there.
+ *
+ * @remarks
+ *  The first call asks the command for a fast path with Command::quicken() and
+ * the site keeps it. The next calls take the fast path directly while the
+ * guard holds: the command is of the class the fast path belongs to and the
+ * arguments are of the same types. When the guard fails, the call takes the
+ * generic path with Command::apply() and the site stays generic from then on,
+ * so a site that sees mixed types doesn't keep asking.
+ *
+ * The state is a single atomic pointer, the threads evaluating the same
+ * program may quicken it concurrently.
+ */
+class CallSite
+{
+    std::atomic<const Quickening *> quickening{nullptr};
+
+    // Marks the sites that fell back to the generic path.
+    static const Quickening generic;
+
+public:
+    CallSite()
+    {
+    }
+
+    CallSite(const CallSite &) = delete;
+    CallSite &operator=(const CallSite &) = delete;
+
+    /**
+     * Calls the command, through the fast path if the guard holds.
+     *
+     * @param [in,out] command The command to call.
+     * @param [in] args The arguments, read according to its signature.
+     *
+     * @return The result of the command.
+     */
+    Value call(Command &command, const Arguments &args);
+
+    /// @return True if the site has a fast path.
+    bool isQuickened() const
+    {
+        const Quickening *current = quickening.load(std::memory_order_relaxed);
+        return current && (current != &generic);
+    }
+};
+} // namespace pfx
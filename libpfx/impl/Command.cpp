@@ -0,0 +1,217 @@
+namespace pfx
+{
+
+/**
+ * Storage for the arguments of a fixed command.
+ *
+ * @remarks
+ *  Short argument lists are kept inline, so reading them doesn't allocate. The
+ * arguments must be added in order.
+ */
+class ArgumentStorage
+{
+    static const size_t inlineCount = 8;
+
+    // Only the first count elements are constructed.
+    alignas(Value) unsigned char inlineValues[inlineCount * sizeof(Value)];
+    Position inlinePositions[inlineCount];
+    std::unique_ptr<unsigned char[]> extraValues;
+    std::unique_ptr<Position[]> extraPositions;
+    Value *values;
+    Position *positions = inlinePositions;
+    size_t count = 0;
+
+public:
+    /**
+     * @param [in] capacity The number of arguments.
+     */
+    explicit ArgumentStorage(size_t capacity)
+        : values(reinterpret_cast<Value *>(inlineValues))
+    {
+        if (capacity > inlineCount)
+        {
+            extraValues.reset(new unsigned char[capacity * sizeof(Value)]);
+            extraPositions.reset(new Position[capacity]);
+            values = reinterpret_cast<Value *>(extraValues.get());
+            positions = extraPositions.get();
+        }
+    }
+
+    ~ArgumentStorage()
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            values[i].~Value();
+        }
+    }
+
+    /**
+     * Adds the next argument.
+     *
+     * @param [in] value The value.
+     * @param [in] position Where the argument starts.
+     */
+    void push(Value &&value, const Position &position)
+    {
+        new (values + count) Value(std::move(value));
+        positions[count] = position;
+        count++;
+    }
+
+    /**
+     * Adds the next argument, borrowing its node.
+     *
+     * @param [in] node The node, it must outlive the storage.
+     * @param [in] position Where the argument starts.
+     */
+    void borrow(const Node &node, const Position &position)
+    {
+        new (values + count) Value(node, Value::Borrow());
+        positions[count] = position;
+        count++;
+    }
+
+    /**
+     * @param [in] cache The cache of the call site.
+     *
+     * @return The view of the arguments passed to Command::apply().
+     */
+    Arguments getArguments(const CacheSlot *cache)
+    {
+        return Arguments(values, positions, count, cache);
+    }
+};
+
+
+/**
+ * A node that evaluates to an already computed value.
+ *
+ * @remarks
+ *  Used to pass evaluated arguments through an iterator.
+ */
+struct EvaluatedNode : Node
+{
+    using Node::evaluate;
+    using Node::evaluateValue;
+
+    /// The value the node evaluates to.
+    const Value value;
+
+    /**
+     * @param [in] value The value the node evaluates to.
+     */
+    explicit EvaluatedNode(Value value) : value(std::move(value))
+    {
+    }
+
+    NodeRef evaluate(ArgIterator &) const override
+    {
+        return value.toNode();
+    }
+
+    Value evaluateValue(ArgIterator &) const override
+    {
+        return value;
+    }
+
+    std::string toString() const override
+    {
+        return value.toString();
+    }
+
+    int toInteger() const override
+    {
+        return value.toInteger();
+    }
+
+    double toDouble() const override
+    {
+        return value.toDouble();
+    }
+
+    NodeType getType() const override
+    {
+        return value.getType();
+    }
+};
+
+
+Value Command::call(ArgIterator &iterator)
+{
+    return execute(iterator);
+}
+
+
+Value Command::apply(const Arguments &args)
+{
+    // Rebuild the argument list. The evaluated arguments are wrapped, so
+    // evaluating them again doesn't run anything.
+    const std::vector<ArgMode> &modes = signature->args;
+    std::pmr::vector<NodeInfo> nodes;
+    nodes.reserve(args.size());
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        NodeRef node = modes[i] == ArgMode::Fetch
+                           ? args[i].toNode()
+                           : makeNode<EvaluatedNode>(args[i]);
+        nodes.emplace_back(std::move(node));
+        nodes.back().start = args.getPosition(i);
+    }
+
+    ArgIterator iterator(nodes.begin(), nodes.end(), args.getCache());
+    return call(iterator);
+}
+
+
+const Quickening *Command::quicken(const Arguments &) const
+{
+    return nullptr;
+}
+
+
+bool Command::isPure(PurityCheck &) const
+{
+    return pure;
+}
+
+
+bool Quickening::accepts(const Arguments &args) const
+{
+    if (args.size() != types.size()) return false;
+    for (size_t i = 0; i < types.size(); i++)
+    {
+        if (args[i].getType() != types[i]) return false;
+    }
+    return true;
+}
+
+
+NodeRef ValueCommand::execute(ArgIterator &iterator)
+{
+    return call(iterator).toNode();
+}
+
+
+Value FixedCommand::call(ArgIterator &iterator)
+{
+    const std::vector<ArgMode> &modes = getSignature()->args;
+    const CacheSlot *cache = iterator.getCache();
+    ArgumentStorage storage(modes.size());
+    for (size_t i = 0; i < modes.size(); i++)
+    {
+        Position position = iterator.getPosition();
+        if (modes[i] == ArgMode::Fetch)
+        {
+            storage.borrow(iterator.fetchNextNode(), position);
+        }
+        else
+        {
+            storage.push(iterator.evaluateNextValue(), position);
+            // The argument requested a tail call, don't run the command.
+            if (TailCall::pending()) return Value();
+        }
+    }
+    return apply(storage.getArguments(cache));
+}
+
+} // namespace pfx
\ No newline at end of file
@@ -3,6 +3,149 @@
 namespace pfx
 {
 
+/// Specifies how a command reads one of its arguments.
+enum class ArgMode : uint8_t
+{
+    Evaluate, ///< The argument is evaluated, like evaluateNext() does.
+    Fetch     ///< The argument node is taken as is, like fetchNext() does.
+};
+
+/// The fixed argument list of a command.
+struct Signature
+{
+    /// How each argument is read, in order.
+    std::vector<ArgMode> args;
+
+    /// Creates the signature of a command without arguments.
+    Signature()
+    {
+    }
+
+    /**
+     * Creates a signature.
+     *
+     * @param [in] args How each argument is read.
+     */
+    Signature(std::initializer_list<ArgMode> args) : args(args)
+    {
+    }
+
+    /**
+     * Creates a signature.
+     *
+     * @param [in] args How each argument is read.
+     */
+    explicit Signature(std::vector<ArgMode> args) : args(std::move(args))
+    {
+    }
+};
+
+/**
+ * The arguments of a command that has a signature, already read according to
+ * it.
+ *
+ * @remarks
+ *  The evaluated arguments are their values, the fetched ones borrow their
+ * node: it stays valid until the command returns, copy the value to keep it.
+ * The missing arguments at the end of a group are null.
+ */
+class Arguments
+{
+    Value *values;
+    const Position *positions;
+    size_t count;
+    const CacheSlot *cache;
+
+public:
+    /**
+     * Creates the argument list.
+     *
+     * @param [in] values The values of the arguments.
+     * @param [in] positions The position each argument starts at.
+     * @param [in] count The number of arguments.
+     * @param [in] cache The cache of the call site, nullptr if there is none.
+     */
+    Arguments(Value *values, const Position *positions, size_t count,
+              const CacheSlot *cache = nullptr)
+        : values(values), positions(positions), count(count), cache(cache)
+    {
+    }
+
+    /**
+     * @return The cache of the call site, nullptr if the command is not called
+     * from a site. See ArgIterator::getCache().
+     */
+    const CacheSlot *getCache() const
+    {
+        return cache;
+    }
+
+    /// @return The number of arguments.
+    size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * @param [in] index The index of the argument.
+     *
+     * @return The argument.
+     */
+    Value &operator[](size_t index) const
+    {
+        return values[index];
+    }
+
+    /**
+     * @param [in] index The index of the argument.
+     *
+     * @return The position where the argument starts, for error reporting.
+     */
+    const Position &getPosition(size_t index) const
+    {
+        return positions[index];
+    }
+};
+
+/**
+ * A fast path of a command for the argument types seen at a call site, see
+ * Command::quicken().
+ *
+ * @remarks
+ *  The call sites only keep a pointer to it, so it must never be destroyed
+ * while the program runs, make it a static variable.
+ */
+struct Quickening
+{
+    /// The tag of the command class it belongs to, see Command::setTag().
+    const void *owner;
+
+    /// The types of the arguments it handles, as Value::getType() reports them.
+    std::vector<NodeType> types;
+
+    /// Computes the result for arguments of those types.
+    Value (*apply)(const Arguments &args);
+
+    /**
+     * Creates a fast path of a command class.
+     *
+     * @param [in] types The types of the arguments it handles.
+     * @param [in] apply Computes the result for arguments of those types.
+     *
+     * @return The fast path of T, which must tag itself with Command::setTag().
+     */
+    template <class T>
+    static Quickening of(std::vector<NodeType> types,
+                         Value (*apply)(const Arguments &args));
+
+    /**
+     * @param [in] args The arguments of a call.
+     *
+     * @return True if the arguments have the types it handles.
+     */
+    bool accepts(const Arguments &args) const;
+};
+
 /// Represents a command to be evaluated in a command node.
 struct Command
 {
@@ -15,6 +158,105 @@ struct Command
      * @return The result of the evaluation.
      */
     virtual NodeRef execute(ArgIterator &iterator) = 0;
+
+    /**
+     * Executes the command producing a value instead of a node.
+     *
+     * @param [in,out] iterator An iterator that can be used to fetch further
+     * nodes during the evaluation.
+     *
+     * @return The result of the evaluation.
+     *
+     * @remarks
+     *  The default implementation wraps the result of execute(). Override it
+     * (or derive from ValueCommand) to return integers and floats without
+     * allocating nodes for them.
+     */
+    virtual Value call(ArgIterator &iterator);
+
+    /**
+     * Executes the command with its arguments already read.
+     *
+     * @param [in] args The arguments read according to the signature.
+     *
+     * @return The result of the evaluation.
+     *
+     * @remarks
+     *  It's only called for commands that have a signature, that's how the
+     * bytecode engine calls them. The default implementation passes the
+     * arguments to call() through an iterator.
+     */
+    virtual Value apply(const Arguments &args);
+
+    /**
+     * Offers a fast path for a call site.
+     *
+     * @param [in] args The arguments of the first call at the site.
+     *
+     * @return The fast path for the types of the arguments, nullptr if there
+     * is none.
+     *
+     * @remarks
+     *  The call sites of the linked calls and of the bytecode ask it once, then
+     * call the fast path directly while the command is of the same class and
+     * the arguments are of the same types. The fast path must compute the same
+     * result as apply() would. The default implementation returns nullptr.
+     */
+    virtual const Quickening *quicken(const Arguments &args) const;
+
+    /**
+     * Tells if running the command has no side effects.
+     *
+     * @param [in,out] check The check asking, to check the nodes the command
+     * runs in turn, like the body of a function.
+     *
+     * @return True if the command only computes its result from its arguments
+     * and the bindings, so it can run in parallel with others. See setPure().
+     *
+     * @remarks
+     *  The arguments are checked separately. The default implementation
+     * returns what the command declared.
+     */
+    virtual bool isPure(PurityCheck &check) const;
+
+    /**
+     * @param [in] quickening A fast path.
+     *
+     * @return True if the fast path belongs to the class of the command.
+     */
+    bool owns(const Quickening &quickening) const
+    {
+        return tag && (quickening.owner == tag);
+    }
+
+    /// @return The arguments the command reads, nullptr if it's not fixed.
+    const Signature *getSignature() const
+    {
+        return signature.get();
+    }
+
+    /**
+     * Downcasts the command to a class that tags itself with setTag().
+     *
+     * @return The command as T, nullptr if it's not a T.
+     *
+     * @remarks
+     *  Only the class that set the tag matches, not its bases. It works
+     * without RTTI.
+     */
+    template <class T>
+    T *as()
+    {
+        return tag == tagOf<T>() ? static_cast<T *>(this) : nullptr;
+    }
+
+    /// @copydoc as()
+    template <class T>
+    const T *as() const
+    {
+        return tag == tagOf<T>() ? static_cast<const T *>(this) : nullptr;
+    }
+
     /// Virtual destructor for polymorphism.
     virtual ~Command()
     {
@@ -24,9 +266,119 @@ struct Command
     {
     }
 
+protected:
+    /**
+     * Declares that the command always reads the same arguments.
+     *
+     * @param [in] signature How the arguments are read.
+     */
+    void setSignature(Signature signature)
+    {
+        this->signature =
+            std::make_unique<const Signature>(std::move(signature));
+    }
+
+    /**
+     * Declares that the command has no side effects: it doesn't print, change
+     * the bindings or the nodes, and doesn't depend on such changes of the
+     * commands evaluated before it. Call it from the constructor.
+     */
+    void setPure()
+    {
+        pure = true;
+    }
+
+    /**
+     * Tags the command as a T, so as<T>() can find it. Call it from the
+     * constructor of T.
+     */
+    template <class T>
+    void setTag()
+    {
+        tag = tagOf<T>();
+    }
+
 private:
+    // The address of a variable that is unique to each class.
+    template <class T>
+    static const void *tagOf()
+    {
+        static const char unique = 0;
+        return &unique;
+    }
+
+    const void *tag = nullptr;
+
+    bool pure = false;
+
+    // Registers the signatures given to setCommand().
+    friend class Context;
+
+    // Takes the tag of the class it belongs to.
+    friend struct Quickening;
+
+    std::unique_ptr<const Signature> signature;
+
     // Owned via references, do not copy.
     Command(const Command &) = delete;
     Command &operator=(const Command &) = delete;
 };
+
+template <class T>
+Quickening Quickening::of(std::vector<NodeType> types,
+                          Value (*apply)(const Arguments &args))
+{
+    return Quickening{Command::tagOf<T>(), std::move(types), apply};
+}
+
+/**
+ * Base for commands that are implemented in terms of values.
+ *
+ * @remarks
+ *  Only call() needs to be implemented, execute() converts its result to a
+ * node for the callers that need one.
+ */
+struct ValueCommand : Command
+{
+    Value call(ArgIterator &iterator) override = 0;
+
+    /**
+     * Runs call() and converts the result to a node.
+     *
+     * @param [in,out] iterator The argument iterator.
+     *
+     * @return The result as a node.
+     */
+    NodeRef execute(ArgIterator &iterator) final;
+};
+
+/**
+ * Base for commands that always read the same arguments.
+ *
+ * @remarks
+ *  Only apply() needs to be implemented. When the command is called through an
+ * iterator, call() reads the arguments according to the signature and passes
+ * them to apply().
+ */
+struct FixedCommand : ValueCommand
+{
+    /**
+     * @param [in] signature How the arguments are read.
+     */
+    explicit FixedCommand(Signature signature)
+    {
+        setSignature(std::move(signature));
+    }
+
+    Value apply(const Arguments &args) override = 0;
+
+    /**
+     * Reads the arguments and runs apply().
+     *
+     * @param [in,out] iterator The argument iterator.
+     *
+     * @return The result of apply().
+     */
+    Value call(ArgIterator &iterator) final;
+};
 } // namespace pfx
\ No newline at end of file
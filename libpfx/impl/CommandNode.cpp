@@ -0,0 +1,49 @@
+namespace pfx
+{
+Binding &CommandNode::bindIn(Environment &environment)
+{
+    uint32_t current = slot.load(std::memory_order_relaxed);
+    if (!current)
+    {
+        // Another thread may give it a slot meanwhile, the first one wins.
+        uint32_t fresh = Environment::newSlot();
+        current = slot.compare_exchange_strong(current, fresh,
+                                               std::memory_order_relaxed)
+                      ? fresh
+                      : current;
+    }
+    return environment.bind(current, shared);
+}
+
+
+void CommandNode::setValue(Value newValue)
+{
+    Binding &binding = changeBinding();
+    binding.command.reset();
+    binding.value = std::move(newValue);
+}
+
+
+void CommandNode::setCommand(std::shared_ptr<Command> newCommand)
+{
+    Binding &binding = changeBinding();
+    binding.command = std::move(newCommand);
+    binding.value = Value();
+}
+
+
+NodeRef CommandNode::evaluate(ArgIterator &hIter) const
+{
+    const Binding &binding = getBinding();
+    if (!binding.command) return binding.value.toNode();
+    return binding.command->execute(hIter);
+}
+
+
+Value CommandNode::evaluateValue(ArgIterator &hIter) const
+{
+    const Binding &binding = getBinding();
+    if (!binding.command) return binding.value;
+    return binding.command->call(hIter);
+}
+} // namespace pfx
@@ -0,0 +1,192 @@
+/// @file CommandNode.hpp Contains the CommandNode class.
+
+namespace pfx
+{
+/**
+ * Represents an user defined command.
+ *
+ * @remarks
+ *  The node is bound to a command or to the value of a variable. The binding
+ * is looked up in the active Environment first, the node only keeps the
+ * shared one.
+ */
+struct CommandNode : Node
+{
+    using Node::evaluate;
+    using Node::evaluateValue;
+
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::Command;
+
+    /// The name of the command. This is stored during the parsing.
+    std::string prettyName;
+
+private:
+    // The binding outside of the environments.
+    Binding shared;
+
+    // Where the environments keep the binding of the node, 0 until it's
+    // bound in one.
+    mutable std::atomic<uint32_t> slot{0};
+
+    // @return The binding to change in the environment.
+    Binding &bindIn(Environment &environment);
+
+    // @return The binding to change, in the active environment if any.
+    Binding &changeBinding()
+    {
+        Environment *environment = Environment::current();
+        return environment ? bindIn(*environment) : shared;
+    }
+
+public:
+    /**
+     * Constructs a command node for the given command.
+     *
+     * @param [in] command The command this node represents.
+     */
+    CommandNode(std::shared_ptr<Command> command)
+        : Node(type), shared{std::move(command), Value()}
+    {
+    }
+
+    /**
+     * Constructs a command node for the given command.
+     *
+     * @param [in] command The command this node represents.
+     * @param [in] name The name of the command refer to.
+     */
+    CommandNode(std::shared_ptr<Command> command, std::string name)
+        : CommandNode(std::move(command))
+    {
+        prettyName = std::move(name);
+    }
+
+    /**
+     * @return The current binding of the name. It's valid until the binding
+     * changes.
+     */
+    const Binding &getBinding() const
+    {
+        if (const Environment *environment = Environment::current())
+        {
+            const Binding *binding =
+                environment->find(slot.load(std::memory_order_relaxed));
+            if (binding) return *binding;
+        }
+        return shared;
+    }
+
+    /// @return The command, empty while the name is a variable.
+    const std::shared_ptr<Command> &getCommand() const
+    {
+        return getBinding().command;
+    }
+
+    /// @return The value of the variable, null if it's not a variable.
+    const Value &getValue() const
+    {
+        return getBinding().value;
+    }
+
+    /// @return True if the name is bound to a variable instead of a command.
+    bool isVariable() const
+    {
+        return !getBinding().command;
+    }
+
+    /**
+     * Binds the name to a variable. Evaluating the node just reads the value,
+     * no command is called.
+     *
+     * @param [in] newValue The value of the variable.
+     */
+    void setValue(Value newValue);
+
+    /**
+     * Binds the name to a command.
+     *
+     * @param [in] newCommand The command.
+     */
+    void setCommand(std::shared_ptr<Command> newCommand);
+
+    /**
+     * Replaces the whole binding.
+     *
+     * @param [in] binding The new binding.
+     *
+     * @return The old binding.
+     */
+    Binding exchangeBinding(Binding binding)
+    {
+        Binding &current = changeBinding();
+        Binding old{std::move(current.command), std::move(current.value)};
+        current.command = std::move(binding.command);
+        current.value = std::move(binding.value);
+        return old;
+    }
+
+    void dump(int /*indent*/) const override
+    {
+        printf("Command: %s", prettyName.c_str());
+    }
+
+    std::string toString() const override
+    {
+        return prettyName;
+    }
+    int toInteger() const override
+    {
+        return 0;
+    }
+    double toDouble() const override
+    {
+        return 0.0;
+    }
+
+    /**
+     * Evaluates the node by running the passed in command.
+     *
+     * @param [in,out] iterator The argument iterator the command use the fetch
+     * more arguments.
+     *
+     * @return The result of the command, the value of the variable if the
+     * name is bound to one.
+     */
+    NodeRef evaluate(ArgIterator &iterator) const override;
+
+    /**
+     * Evaluates the node by calling the passed in command.
+     *
+     * @param [in,out] iterator The argument iterator the command use the fetch
+     * more arguments.
+     *
+     * @return The result of the command, the value of the variable if the
+     * name is bound to one.
+     */
+    Value evaluateValue(ArgIterator &iterator) const override;
+
+    /// @return NodeType::Command
+    NodeType getType() const override
+    {
+        return NodeType::Command;
+    };
+};
+
+inline CommandRef Node::asCommand()
+{
+    return CommandRef(as<CommandNode>());
+}
+
+/**
+ * creates a command node.
+ *
+ * @param [in] command The command callback it represents.
+ *
+ * @return The node.
+ */
+inline CommandRef createCommand(CommandCallbackRef command)
+{
+    return makeNode<CommandNode>(command);
+}
+} // namespace pfx
@@ -0,0 +1,65 @@
+/// @file CompiledProgram.hpp Contains the CompiledProgram class.
+
+namespace pfx
+{
+/**
+ * Handle of a program compiled into an arena.
+ *
+ * @remarks
+ *  The group nodes of the program, their child lists and the strings not in
+ * the constant pool are allocated from the arena. The arena is freed in one go
+ * when the program and every node of it that was stored elsewhere are gone.
+ */
+class CompiledProgram
+{
+    Ref<Arena> arena;
+    GroupRef root;
+
+public:
+    /**
+     * Creates the handle.
+     *
+     * @param [in] root The root group of the program.
+     * @param [in] arena The arena the program is allocated from.
+     */
+    CompiledProgram(GroupRef root, Ref<Arena> arena)
+        : arena(std::move(arena)), root(std::move(root))
+    {
+    }
+
+    /// @return The root group of the program.
+    const GroupRef &getRoot() const
+    {
+        return root;
+    }
+
+    /// @return The arena the program is allocated from.
+    const Ref<Arena> &getArena() const
+    {
+        return arena;
+    }
+
+    /**
+     * Runs the program.
+     *
+     * @return The result of the root group.
+     */
+    NodeRef evaluate() const
+    {
+        return root->evaluate();
+    }
+
+    /**
+     * Runs the program in an environment, the changes of the bindings go
+     * there. See Environment.
+     *
+     * @param [in,out] environment The environment of this thread.
+     *
+     * @return The result of the root group.
+     */
+    Value evaluate(Environment &environment) const
+    {
+        return environment.evaluate(*root);
+    }
+};
+} // namespace pfx
@@ -0,0 +1,110 @@
+namespace pfx
+{
+NodeRef ConstantPool::integer(int value)
+{
+    if ((smallIntegerMin <= value) && (value <= smallIntegerMax))
+    {
+        // These are preallocated anyway.
+        return createInteger(value);
+    }
+
+    NodeRef &node = integers[value];
+    if (!node) node = makeNode<IntegerNode>(value);
+    return node;
+}
+
+NodeRef ConstantPool::floating(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    NodeRef &node = floats[bits];
+    if (!node) node = makeNode<FloatNode>(value);
+    return node;
+}
+
+NodeRef ConstantPool::string(std::string_view value)
+{
+    auto iter = strings.find(value);
+    if (iter != strings.end())
+    {
+        return iter->second;
+    }
+
+    auto node = makeNode<StringNode>(std::string(value));
+    // The key must point to the pooled copy.
+    strings.emplace(node->value, node);
+    return node;
+}
+
+GroupRef ConstantPool::group(const GroupRef &group)
+{
+    if (!groupSharing)
+    {
+        return group;
+    }
+
+    std::vector<const Node *> children;
+    children.reserve(group->nodes.size());
+    for (const NodeInfo &child : group->nodes)
+    {
+        const Node *node = child.node.get();
+        switch (node->getType())
+        {
+        case NodeType::Integer:
+        case NodeType::FloatingPoint:
+        case NodeType::String:
+            break;
+        case NodeType::Group:
+            // Child groups are literal only if they got pooled.
+            if (!pooledGroups.count(node)) return group;
+            break;
+        default:
+            return group;
+        }
+        children.push_back(node);
+    }
+
+    auto inserted = groups.emplace(std::move(children), group);
+    if (inserted.second)
+    {
+        pooledGroups.insert(group.get());
+    }
+    return inserted.first->second;
+}
+
+/// Removes the entries only the pool refers to.
+template <class Map, class Callback>
+static void sweepMap(Map &map, Callback onRemove)
+{
+    for (auto iter = map.begin(); iter != map.end();)
+    {
+        if (iter->second.use_count() == 1)
+        {
+            onRemove(iter->second.get());
+            iter = map.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+void ConstantPool::sweep()
+{
+    if (size() < sweepLimit)
+    {
+        return;
+    }
+
+    auto ignore = [](const Node *) {};
+    // Groups first, they hold references to the other literals.
+    sweepMap(groups, [this](const Node *n) { pooledGroups.erase(n); });
+    sweepMap(integers, ignore);
+    sweepMap(floats, ignore);
+    sweepMap(strings, ignore);
+
+    sweepLimit = std::max<size_t>(1024, size() * 2);
+}
+} // namespace pfx
@@ -0,0 +1,116 @@
+/// @file ConstantPool.hpp Contains the ConstantPool class.
+
+namespace pfx
+{
+/**
+ * Deduplicates the literal nodes of the compiled code.
+ *
+ * @remarks
+ * Literal nodes are immutable, so identical literals can share a single node.
+ * Groups that contain only literals can be shared too, but this is optional:
+ * the positions in a shared group are the positions of its first occurrence
+ * and groups can be modified through their nodes vector.
+ *
+ * The pool keeps the nodes alive, sweep() releases the nodes nothing else
+ * refers to.
+ */
+class ConstantPool
+{
+    /// Hashes floats by their bits, so -0.0 and 0.0 stay different.
+    struct FloatHash
+    {
+        size_t operator()(uint64_t bits) const
+        {
+            return std::hash<uint64_t>()(bits);
+        }
+    };
+
+    /// Hashes the child list of a literal only group.
+    struct ChildrenHash
+    {
+        size_t operator()(const std::vector<const Node *> &children) const
+        {
+            size_t h = children.size();
+            for (const Node *child : children)
+            {
+                h = h * 31 + std::hash<const Node *>()(child);
+            }
+            return h;
+        }
+    };
+
+    std::unordered_map<int, NodeRef> integers;
+    std::unordered_map<uint64_t, NodeRef, FloatHash> floats;
+    // The keys point into the pooled string nodes.
+    std::unordered_map<std::string_view, NodeRef> strings;
+    std::unordered_map<std::vector<const Node *>, GroupRef, ChildrenHash>
+        groups;
+    // The pooled groups for fast checking whether a group is pooled.
+    std::unordered_set<const Node *> pooledGroups;
+
+    bool groupSharing = false;
+    size_t sweepLimit = 1024; // Sweep when the pool grows this big.
+
+public:
+    /// Strings longer than this are borrowed from the source, not pooled.
+    static const size_t maxPooledString = 64;
+
+    /**
+     * @param [in] value The value of the literal.
+     *
+     * @return The integer node of the value.
+     */
+    NodeRef integer(int value);
+
+    /**
+     * @param [in] value The value of the literal.
+     *
+     * @return The float node of the value.
+     */
+    NodeRef floating(double value);
+
+    /**
+     * @param [in] value The value of the literal. It's copied when a new node
+     * is made.
+     *
+     * @return The string node of the value.
+     */
+    NodeRef string(std::string_view value);
+
+    /**
+     * @param [in] group A freshly compiled group.
+     *
+     * @return A pooled group identical to the given one. Or the group itself
+     * if it contains anything but literals or sharing is disabled.
+     */
+    GroupRef group(const GroupRef &group);
+
+    /**
+     * @param [in] enabled Enables or disables the sharing of literal only
+     * groups. It's disabled by default.
+     */
+    void setGroupSharing(bool enabled)
+    {
+        groupSharing = enabled;
+    }
+
+    /// @return True if the literal only groups are shared.
+    bool hasGroupSharing() const
+    {
+        return groupSharing;
+    }
+
+    /// @return The number of pooled nodes.
+    size_t size() const
+    {
+        return integers.size() + floats.size() + strings.size() +
+               groups.size();
+    }
+
+    /**
+     * Releases the pooled nodes that are not used anywhere else, when the
+     * pool grew big enough since the last sweep.
+     */
+    void sweep();
+};
+} // namespace pfx
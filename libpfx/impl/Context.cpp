@@ -3,27 +3,48 @@ namespace pfx
 void Context::setCommand(const std::string &name,
                          const std::shared_ptr<Command> &command)
 {
-    auto iter = commands.find(name);
+    CommandNode *node = commands.find(name);
 
-    if (iter == commands.end())
+    if (!node)
     {
         // New command
-        commands[name] = std::make_shared<CommandNode>(command, name);
+        commands.insert(makeNode<CommandNode>(command, name));
     }
     else
     {
-        // Existing command overwrite.
-        iter->second->prettyName = name;
-        iter->second->command = command;
+        // Existing command overwrite, it may have been a variable.
+        node->setCommand(command);
     }
 }
 
+void Context::setCommand(const std::string &name,
+                         const std::shared_ptr<Command> &command,
+                         const Signature &signature)
+{
+    const Signature *current = command->getSignature();
+    if (!current)
+    {
+        command->signature = std::make_unique<const Signature>(signature);
+    }
+    else if (current->args != signature.args)
+    {
+        throw error::InvalidOperation(
+            Position(), "Signature mismatch: the command '" + name +
+                            "' already has a different signature.");
+    }
+
+    setCommand(name, command);
+}
+
 struct UndefinedCommand : Command
 {
     Position pos;
+    std::shared_ptr<const SourceMap> source; // Keeps the position valid.
 
-    UndefinedCommand(Position pos) : pos(pos)
+    UndefinedCommand(Position pos, std::shared_ptr<const SourceMap> source)
+        : pos(pos), source(std::move(source))
     {
+        setTag<UndefinedCommand>();
     }
 
     NodeRef execute(ArgIterator &) override
@@ -33,113 +54,497 @@ struct UndefinedCommand : Command
 };
 
 
-std::shared_ptr<GroupNode> Context::compileCode(Input &input)
+/// @return True if the command was never defined, so it can be forgotten.
+static bool isUndefinedCommand(const CommandNode &node)
+{
+    const std::shared_ptr<Command> &command = node.getCommand();
+    return command && command->as<UndefinedCommand>();
+}
+
+
+/// A group being compiled, the children are collected until it's closed.
+struct OpenGroup
+{
+    GroupRef group;
+    std::vector<NodeInfo> children;
+
+    /// Moves the children into the group, allocating the list only once.
+    void close()
+    {
+        group->nodes.reserve(children.size());
+        group->nodes.assign(std::make_move_iterator(children.begin()),
+                            std::make_move_iterator(children.end()));
+        children.clear();
+    }
+};
+
+
+/// Links the calls in the compiled groups, see Context::setCallLinking().
+struct CallLinker
+{
+    Arena *arena; // The calls are allocated from here.
+
+    // The nested groups waiting to be linked, they can be deep.
+    std::vector<GroupNode *> groups;
+
+    /**
+     * Links the calls among the children of the group and its child groups.
+     *
+     * @param [in,out] root The group to link.
+     */
+    void link(GroupNode &root)
+    {
+        groups.push_back(&root);
+        while (!groups.empty())
+        {
+            GroupNode &group = *groups.back();
+            groups.pop_back();
+
+            std::pmr::vector<NodeInfo> linked(group.nodes.get_allocator());
+            linked.reserve(group.nodes.size());
+            size_t i = 0;
+            while (i < group.nodes.size())
+            {
+                bool closed;
+                linked.push_back(linkNext(group.nodes, i, false, closed));
+            }
+            group.nodes.swap(linked);
+        }
+    }
+
+    /**
+     * Links the node with its arguments.
+     *
+     * @param [in] nodes The children of the group.
+     * @param [in,out] i The index of the node, it's moved past its arguments.
+     * @param [in] argument True if the node is evaluated as an argument.
+     * @param [out] closed False if the node is a command with unknown
+     * arguments, so the arguments after it can't be linked.
+     *
+     * @return The node, or the call linked from it.
+     */
+    NodeInfo linkNext(const std::pmr::vector<NodeInfo> &nodes, size_t &i,
+                      bool argument, bool &closed)
+    {
+        const NodeInfo &info = nodes[i++];
+        closed = true;
+        if (GroupNode *group = info.node->as<GroupNode>())
+        {
+            groups.push_back(group);
+        }
+        auto *command = info.node->as<CommandNode>();
+        if (!command)
+        {
+            return info;
+        }
+
+        if (command->isVariable())
+        {
+            // Nothing to link, the value is read when it's evaluated.
+            return info;
+        }
+        const Signature *signature = command->getCommand()->getSignature();
+        if (!signature)
+        {
+            closed = false;
+            return info;
+        }
+        if (signature->args.empty() && !argument)
+        {
+            // Nothing to link, the node is left as it is.
+            return info;
+        }
+
+        size_t first = i;
+        Ref<CallNode> call = makeNodeIn<CallNode>(
+            arena, CommandRef(command), signature->args, info.start,
+            nodes.get_allocator().resource());
+        call->args.reserve(signature->args.size());
+        for (ArgMode mode : signature->args)
+        {
+            if (i == nodes.size())
+            {
+                throw error::MissingArgument(info.start);
+            }
+
+            if (mode == ArgMode::Fetch)
+            {
+                const NodeInfo &arg = nodes[i++];
+                if (GroupNode *group = arg.node->as<GroupNode>())
+                {
+                    groups.push_back(group);
+                }
+                call->args.push_back(arg);
+                continue;
+            }
+
+            bool argClosed;
+            call->args.push_back(linkNext(nodes, i, true, argClosed));
+            if (!argClosed)
+            {
+                // Who knows where the arguments of that command end.
+                i = first;
+                closed = false;
+                return info;
+            }
+        }
+
+        NodeInfo result(call);
+        result.start = info.start;
+        result.end = call->args.empty() ? info.end : call->args.back().end;
+        return result;
+    }
+};
+
+
+GroupRef Context::compileCode(Input &input)
+{
+    return compile(input, nullptr);
+}
+
+
+CompiledProgram Context::compileProgram(Input &input)
+{
+    Ref<Arena> arena(new Arena());
+    GroupRef root = compile(input, arena.get());
+    return CompiledProgram(std::move(root), std::move(arena));
+}
+
+
+/// The names an input left undefined, with the nodes made for them.
+struct Context::NewCommands
+{
+    // The keys are the names of the nodes.
+    std::unordered_map<std::string_view, CommandRef> nodes;
+    // In the order of the first occurrences.
+    std::vector<CommandRef> order;
+};
+
+
+/**
+ * Replaces the command nodes in the tree, the nodes of the names another input
+ * defined first.
+ *
+ * @param [in,out] root The tree to update.
+ * @param [in] replacements The replacement of each node to replace.
+ */
+static void replaceCommands(
+    GroupNode &root,
+    const std::unordered_map<const Node *, CommandRef> &replacements)
 {
-    std::string word;
+    std::vector<GroupNode *> groups{&root};
+    while (!groups.empty())
+    {
+        GroupNode &group = *groups.back();
+        groups.pop_back();
+        for (NodeInfo &child : group.nodes)
+        {
+            if (GroupNode *nested = child.node->as<GroupNode>())
+            {
+                groups.push_back(nested);
+                continue;
+            }
+            auto found = replacements.find(child.node.get());
+            if (found != replacements.end()) child.node = found->second;
+        }
+    }
+}
 
+
+std::vector<GroupRef> Context::compileCode(const std::vector<Input *> &inputs)
+{
+    // Drop the literals and the undefined commands of the code that's gone.
+    constants.sweep();
+    commands.sweep(isUndefinedCommand);
+
+    // The table is only read while the inputs are built.
+    size_t count = inputs.size();
+    std::vector<GroupRef> roots(count);
+    std::vector<NewCommands> newCommands(count);
+    ThreadPool &threads = getThreadPool();
+    threads.run(count, [&](size_t i) {
+        ConstantPool pool;
+        pool.setGroupSharing(constants.hasGroupSharing());
+        roots[i] =
+            build(*inputs[i], nullptr, pool, &newCommands[i], threads);
+    });
+
+    // The first input using a name defines it, like in a sequential
+    // compilation. The later ones switch to its node.
+    std::unordered_map<const Node *, CommandRef> replacements;
+    for (NewCommands &names : newCommands)
+    {
+        for (CommandRef &node : names.order)
+        {
+            if (CommandNode *first = commands.find(node->prettyName))
+            {
+                replacements.emplace(node.get(), CommandRef(first));
+            }
+            else
+            {
+                commands.insert(node);
+            }
+        }
+    }
+
+    threads.run(count, [&](size_t i) {
+        if (!replacements.empty()) replaceCommands(*roots[i], replacements);
+        finish(*roots[i], nullptr);
+    });
+    return roots;
+}
+
+
+GroupRef Context::compile(Input &input, Arena *arena)
+{
+    // Drop the literals and the undefined commands of the code that's gone.
+    constants.sweep();
+    commands.sweep(isUndefinedCommand);
+
+    GroupRef root =
+        build(input, arena, constants, nullptr, getThreadPool());
+    finish(*root, arena);
+    return root;
+}
+
+
+GroupRef Context::build(Input &input, Arena *arena, ConstantPool &pool,
+                        NewCommands *newCommands, ThreadPool &threads)
+{
     Token token;
-    std::stack<std::shared_ptr<GroupNode>> groupStack;
+    // The open groups. The child vectors are reused between the groups.
+    std::vector<OpenGroup> groupStack(1);
+    size_t depth = 0;
 
-    groupStack.push(std::make_shared<GroupNode>());
+    const std::shared_ptr<const SourceMap> &source = input.getSourceMap();
 
-    while (readWord(input, token))
+    auto newGroup = [&]() {
+        GroupRef gn = arena ? makeNodeIn<GroupNode>(arena, arena)
+                            : makeNode<GroupNode>();
+        gn->source = source;
+        return gn;
+    };
+    groupStack[0].group = newGroup();
+
+    // Split the rest of the input into tokens in one go.
+    TokenTable table;
+    const char *base = input.data();
+    tokenize(base, input.dataEnd(), table, threads);
+
+    for (size_t i = 0; i < table.size(); i++)
     {
         // For each word...
-        char *endptr;
-        GroupNode *currentGroup = groupStack.top().get();
+        const char *wordStart = base + table.offsets[i];
+        token.start = input.getPosition(wordStart);
+        token.end = input.getPosition(wordStart + table.lengths[i]);
+
+        token.quoted = table.flags[i] & TokenTable::Quoted;
+        token.escaped = table.flags[i] & TokenTable::Escaped;
+        token.word = table.text(base, i);
+        if (token.escaped)
+        {
+            token.unescaped = unescapeQuotes(token.word);
+            token.word = token.unescaped;
+        }
+
+        std::vector<NodeInfo> &currentGroup = groupStack[depth].children;
 
         if (token.quoted)
         {
-            // Quoted strings always create a string node.
-            NodeRef newNode =
-                std::make_shared<StringNode>(token.word);
-            currentGroup->nodes.push_back(NodeInfo(newNode, token));
+            // Quoted strings always create a string node. Short ones are
+            // pooled, long ones are borrowed from the source unless it had to
+            // be unescaped.
+            NodeRef newNode;
+            if (token.word.size() <= ConstantPool::maxPooledString)
+            {
+                newNode = pool.string(token.word);
+            }
+            else if (token.escaped)
+            {
+                newNode =
+                    makeNodeIn<StringNode>(arena, std::string(token.word));
+            }
+            else
+            {
+                newNode = makeNodeIn<StringNode>(arena, token.word,
+                                                 input.getSource());
+            }
+            currentGroup.push_back(NodeInfo(newNode, token));
             continue;
         }
 
-        int intValue = strtol(token.word.c_str(), &endptr, 10);
-        if (*endptr == '\0')
+        WordClass wordClass = classifyWord(token.word);
+        if (wordClass.kind == WordKind::Integer)
         {
             // The whole word parsed as int.
-            NodeRef newNode =
-                std::make_shared<IntegerNode>(intValue);
-            currentGroup->nodes.push_back(NodeInfo(newNode, token));
+            NodeRef newNode = pool.integer(wordClass.integer);
+            currentGroup.push_back(NodeInfo(newNode, token));
             continue;
         }
 
-        double floatValue = strtod(token.word.c_str(), &endptr);
-        if (*endptr == '\0')
+        if (wordClass.kind == WordKind::Float)
         {
             // The whole word parsed as double.
-            NodeRef newNode =
-                std::make_shared<FloatNode>(floatValue);
-            currentGroup->nodes.push_back(NodeInfo(newNode, token));
+            NodeRef newNode = pool.floating(wordClass.floating);
+            currentGroup.push_back(NodeInfo(newNode, token));
             continue;
         }
 
         if (token.word == "(")
         {
             // New Group
-            std::shared_ptr<GroupNode> gn = std::make_shared<GroupNode>();
-            currentGroup->nodes.push_back(NodeInfo(gn, token));
-            groupStack.push(gn);
+            GroupRef gn = newGroup();
+            currentGroup.push_back(NodeInfo(gn, token));
+            depth++;
+            if (depth == groupStack.size()) groupStack.emplace_back();
+            groupStack[depth].group = std::move(gn);
             continue;
         }
 
         if (token.word == ")")
         {
             // Close current group
-            groupStack.pop();
-            if (groupStack.size() == 0)
+            if (depth == 0)
             {
-                // We popped the root node, it shouldn't happen.
+                // We would close the root node, it shouldn't happen.
                 throw error::ClosingBraceWithoutOpeningOne(token.start);
             }
-            groupStack.top()->nodes.back().end = token.end;
+            OpenGroup &closed = groupStack[depth];
+            closed.close();
+            depth--;
+
+            NodeInfo &closedInfo = groupStack[depth].children.back();
+            closedInfo.end = token.end;
+            // Literal only groups may be shared.
+            closedInfo.node = pool.group(closed.group);
+            closed.group = nullptr;
             continue;
         }
 
         // The default case is that the word is a command.
-        auto cmd = commands.find(token.word);
+        CommandNode *cmd = commands.find(token.word);
+        if (!cmd && newCommands)
+        {
+            auto found = newCommands->nodes.find(token.word);
+            if (found != newCommands->nodes.end()) cmd = found->second.get();
+        }
 
         NodeRef newNode;
-        if (cmd == commands.end())
+        if (!cmd)
         {
             // Unregistered commands will get the UndefinedCommand handler
             // registered for them.
-            std::shared_ptr<CommandNode> tmp = std::make_shared<CommandNode>(
-                std::make_shared<UndefinedCommand>(token.start), token.word);
-            commands[token.word] = tmp;
+            CommandRef tmp = makeNode<CommandNode>(
+                std::make_shared<UndefinedCommand>(token.start, source),
+                std::string(token.word));
+            if (newCommands)
+            {
+                newCommands->nodes.emplace(tmp->prettyName, tmp);
+                newCommands->order.push_back(tmp);
+            }
+            else
+            {
+                commands.insert(tmp);
+            }
             newNode = tmp;
         }
         else
         {
             // For registered commands the registered node is reused.
-            newNode = cmd->second;
+            newNode = NodeRef(cmd);
         }
 
-        currentGroup->nodes.push_back(NodeInfo(newNode, token));
+        currentGroup.push_back(NodeInfo(newNode, token));
     }
-    if (groupStack.size() > 1)
+    // The whole input is consumed.
+    input.advance(input.dataEnd());
+
+    if (depth > 0)
     {
-        // At the end only the root node must be on the stack.
+        // At the end only the root node must be open.
         throw error::ClosingBraceExpected(token.start);
     }
 
-    return std::shared_ptr<GroupNode>(groupStack.top());
+    groupStack[0].close();
+    return groupStack[0].group;
+}
+
+
+void Context::finish(GroupNode &root, Arena *arena) const
+{
+    if (linking)
+    {
+        CallLinker{arena, {}}.link(root);
+    }
+    if (bytecode)
+    {
+        root.compileBytecode();
+    }
+}
+
+
+ThreadPool &Context::getThreadPool()
+{
+    if (!pool)
+    {
+        pool = std::make_shared<ThreadPool>(ThreadPool::hardwareThreads());
+    }
+    return *pool;
+}
+
+
+std::shared_ptr<ThreadPool> Context::getSharedThreadPool()
+{
+    getThreadPool();
+    return pool;
+}
+
+
+void Context::setThreadCount(size_t threadCount)
+{
+    getThreadPool().resize(threadCount);
 }
 
 
 std::shared_ptr<Command> Context::getCommand(const std::string &name)
 {
-    auto iter = commands.find(name);
+    CommandNode *node = commands.find(name);
 
-    if (iter == commands.end())
+    if (!node)
     {
         // When not found we return null.
         return std::shared_ptr<Command>();
     }
-    return iter->second->command;
+    return node->getCommand();
+}
+
+
+void Context::setVariable(const std::string &name, Value value)
+{
+    CommandNode *node = commands.find(name);
+
+    if (!node)
+    {
+        Ref<CommandNode> variable = makeNode<CommandNode>(nullptr, name);
+        variable->setValue(std::move(value));
+        commands.insert(std::move(variable));
+    }
+    else
+    {
+        node->setValue(std::move(value));
+    }
+}
+
+
+Value Context::getVariable(const std::string &name)
+{
+    CommandNode *node = commands.find(name);
+
+    if (!node || !node->isVariable())
+    {
+        return Value();
+    }
+    return node->getValue();
 }
 
 } // namespace pfx
\ No newline at end of file
@@ -8,12 +8,43 @@ class CommandNode;
 
 class GroupNode;
 
+class CompiledProgram;
+
 /// Defines the context from which the library can be used.
 class Context
 {
     // Map command names to nodes. All command nodes with identical text are the
     // same.
-    std::map<std::string, std::shared_ptr<CommandNode>> commands;
+    // The lookup is done with string views straight from the tokens.
+    SymbolTable commands;
+
+    // Identical literals of the compiled code share their nodes.
+    ConstantPool constants;
+
+    // Compile the bytecode of the compiled code.
+    bool bytecode = false;
+
+    // Link the calls of the commands that have a signature.
+    bool linking = false;
+
+    // Runs the parallel commands, created on demand.
+    std::shared_ptr<ThreadPool> pool;
+
+    // The names a parallel compilation found undefined, see build().
+    struct NewCommands;
+
+    // Compiles the code, allocates the nodes from the arena if it's given.
+    GroupRef compile(Input &input, Arena *arena);
+
+    // Builds the tree of the code. The literals are pooled in the given pool.
+    // The undefined names are added to the table, or to newCommands if it's
+    // given, then the table is only read. Big sources are tokenized on the
+    // threads.
+    GroupRef build(Input &input, Arena *arena, ConstantPool &pool,
+                   NewCommands *newCommands, ThreadPool &threads);
+
+    // Links the calls and compiles the bytecode of a built tree, as enabled.
+    void finish(GroupNode &root, Arena *arena) const;
 
 public:
     /**
@@ -29,6 +60,25 @@ public:
     void setCommand(const std::string &name,
                     const std::shared_ptr<Command> &command);
 
+    /**
+     * Registers a command that always reads the same arguments.
+     *
+     * @param [in] name The name of the command.
+     * @param [in] command The command functor to register.
+     * @param [in] signature How the command reads its arguments.
+     *
+     * @throw error::InvalidOperation When the command already has a different
+     * signature.
+     *
+     * @remarks
+     *  The bytecode engine and the call linking read the arguments of the
+     * command according to the signature, so the command must read exactly
+     * those arguments.
+     */
+    void setCommand(const std::string &name,
+                    const std::shared_ptr<Command> &command,
+                    const Signature &signature);
+
     /**
      * @param [in] name The command name to look for.
      *
@@ -37,6 +87,126 @@ public:
      */
     std::shared_ptr<Command> getCommand(const std::string &name);
 
+    /**
+     * Binds a name to a variable.
+     *
+     * @param [in] name The name of the variable.
+     * @param [in] value The value of the variable.
+     *
+     * @remarks
+     *  Evaluating the command nodes of the name reads the value directly,
+     * without calling a command. Overwrites the command of the name, if any,
+     * and setCommand() overwrites the variable. See CommandNode::setValue().
+     */
+    void setVariable(const std::string &name, Value value);
+
+    /**
+     * @param [in] name The variable name to look for.
+     *
+     * @return The value of the variable. Null if the name is not a variable.
+     */
+    Value getVariable(const std::string &name);
+
+    /**
+     * Seals the commands registered so far.
+     *
+     * @remarks
+     *  The sealed commands are looked up from a perfect hash table during
+     * compilation. They can still be overwritten by setCommand, commands
+     * registered later just don't get the fast path. It's meant to be called
+     * after registering a fixed set of builtins.
+     */
+    void sealCommands()
+    {
+        commands.seal();
+    }
+
+    /**
+     * Enables or disables the sharing of groups containing only literals
+     * (including such groups) during compilation.
+     *
+     * @param [in] enabled True to enable.
+     *
+     * @remarks
+     *  It's disabled by default. When enabled, the positions inside a shared
+     * group refer to its first occurrence and modifying the nodes of a
+     * compiled group affects all of its occurrences.
+     */
+    void setConstantGroupSharing(bool enabled)
+    {
+        constants.setGroupSharing(enabled);
+    }
+
+    /**
+     * Enables or disables compiling the bytecode of the compiled code.
+     *
+     * @param [in] enabled True to enable.
+     *
+     * @remarks
+     *  It's disabled by default. When enabled, the compiled groups are
+     * evaluated by the bytecode engine instead of walking the tree. See
+     * GroupNode::compileBytecode().
+     */
+    void setBytecodeCompilation(bool enabled)
+    {
+        bytecode = enabled;
+    }
+
+    /**
+     * Enables or disables linking the calls during compilation.
+     *
+     * @param [in] enabled True to enable.
+     *
+     * @remarks
+     *  It's disabled by default. When enabled, the commands that have a
+     * signature are compiled into CallNode objects that hold their arguments.
+     * An argument evaluated by such call must be a literal, a group or a
+     * linked call itself, otherwise the call is left as it is. A call that
+     * runs out of arguments at the end of its group is an error.
+     */
+    void setCallLinking(bool enabled)
+    {
+        linking = enabled;
+    }
+
+    /**
+     * @return The thread pool of the parallel commands. It's created on the
+     * first call with a worker for each hardware thread.
+     *
+     * @remarks
+     *  Get it while setting up the context, the creation is not thread safe.
+     * The reference is valid while the context lives, the commands that keep
+     * the pool should take getSharedThreadPool() instead.
+     */
+    ThreadPool &getThreadPool();
+
+    /**
+     * @return The thread pool of the parallel commands, see getThreadPool().
+     *
+     * @remarks
+     *  The compiled nodes keep their commands alive, so the code compiled by
+     * a context can still run after the context is destroyed. A command that
+     * runs on the pool must keep this pointer, not the getThreadPool()
+     * reference, so the pool lives as long as the command.
+     */
+    std::shared_ptr<ThreadPool> getSharedThreadPool();
+
+    /**
+     * Sets the number of workers of the thread pool.
+     *
+     * @param [in] threadCount The number of workers, 0 runs the parallel
+     * commands on the calling thread.
+     *
+     * @throw error::InvalidOperation When the pool is running a parallel
+     * command.
+     *
+     * @remarks
+     *  The pool may have run already, compiling a big source or several
+     * inputs uses it too. Its workers are stopped then, the next parallel
+     * command starts the new ones.
+     */
+    void setThreadCount(size_t threadCount);
+
     /**
      * Compiles source from the given input source.
      *
@@ -48,7 +218,54 @@ public:
      * without the corresponding opening one.
      * @throw error::ClosingBraceExpected When there are unclosed braces at the
      * end of the parsing.
+     * @throw error::MissingArgument When a linked call runs out of arguments.
+     *
+     * @remarks
+     *  Sources of a few megabytes or more are tokenized on the thread pool,
+     * see getThreadPool().
+     */
+    GroupRef compileCode(Input &input);
+
+    /**
+     * Compiles several inputs in parallel, on the thread pool.
+     *
+     * @param[in,out] inputs The inputs the code is read from.
+     *
+     * @return The group node of each input, in the order of the inputs.
+     *
+     * @throw error::ClosingBraceWithoutOpeningOne On finding a closing brace
+     * without the corresponding opening one.
+     * @throw error::ClosingBraceExpected When there are unclosed braces at the
+     * end of the parsing.
+     * @throw error::MissingArgument When a linked call runs out of arguments.
+     * The error of the first failing input is thrown.
+     *
+     * @remarks
+     *  The result is the same as compiling the inputs one by one with
+     * compileCode(), except the literals are only shared within an input.
+     * Each input is tokenized and built on its own, the names they leave
+     * undefined are added to the context at the end in the order of the
+     * inputs. See getThreadPool().
+     */
+    std::vector<GroupRef> compileCode(const std::vector<Input *> &inputs);
+
+    /**
+     * Compiles source from the given input source into an arena.
+     *
+     * @param[in,out] input The input the code is read from.
+     *
+     * @return The handle of the compiled program.
+     *
+     * @throw error::ClosingBraceWithoutOpeningOne On finding a closing brace
+     * without the corresponding opening one.
+     * @throw error::ClosingBraceExpected When there are unclosed braces at the
+     * end of the parsing.
+     * @throw error::MissingArgument When a linked call runs out of arguments.
+     *
+     * @remarks
+     *  The same as compileCode, but the nodes are allocated from a single
+     * arena which is freed at once.
      */
-    std::shared_ptr<GroupNode> compileCode(Input &input);
+    CompiledProgram compileProgram(Input &input);
 };
 } // namespace pfx
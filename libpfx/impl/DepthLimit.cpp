@@ -0,0 +1,183 @@
+namespace pfx
+{
+std::atomic<size_t> DepthLimit::limit(DepthLimit::defaultLimit);
+thread_local size_t DepthLimit::depth = 0;
+thread_local DepthLimit::Reserve DepthLimit::reserve;
+
+// Leave room for the calls between two levels and for the throw.
+static size_t reserveFor(size_t stackSize)
+{
+    return std::min<size_t>(256 * 1024, stackSize / 4);
+}
+
+
+void DepthLimit::measure()
+{
+    char here;
+    uintptr_t low = 0;
+    size_t size = 0;
+
+#if defined(__APPLE__)
+    pthread_t self = pthread_self();
+    size = pthread_get_stacksize_np(self);
+    low = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(self)) - size;
+#elif defined(__linux__)
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+    {
+        void *address = nullptr;
+        if (pthread_attr_getstack(&attributes, &address, &size) == 0)
+        {
+            low = reinterpret_cast<uintptr_t>(address);
+        }
+        pthread_attr_destroy(&attributes);
+    }
+#endif
+
+    if (!low || !size)
+    {
+        size = 512 * 1024;
+        low = reinterpret_cast<uintptr_t>(&here) - size;
+    }
+
+    reserve.start = low;
+    reserve.size = reserveFor(size);
+}
+
+
+#if defined(__linux__)
+namespace
+{
+// The size of a stack segment, only the touched pages use memory.
+const size_t segmentSize = 8 * 1024 * 1024;
+
+// A stack segment mapped for the evaluations.
+struct Segment
+{
+    void *memory = nullptr;
+
+    ~Segment()
+    {
+        if (memory) munmap(memory, segmentSize);
+    }
+};
+
+// The last segment the thread returned from, kept for its next switch.
+thread_local Segment spare;
+
+// A switch to a segment that runs a body.
+struct StackSwitch
+{
+    void (*body)(void *);
+    void *argument;
+    std::exception_ptr error;
+    ucontext_t caller;
+    ucontext_t callee;
+#if defined(PFX_ASAN)
+    const void *callerBottom = nullptr;
+    size_t callerSize = 0;
+#endif
+#if defined(PFX_TSAN)
+    void *callerFiber = nullptr;
+#endif
+};
+
+// The switch the segment starting on this thread runs.
+thread_local StackSwitch *starting = nullptr;
+
+// The entry of the segments. It doesn't return, the sanitizers would see the
+// return on the stack of the caller.
+void runSegment()
+{
+    StackSwitch &stackSwitch = *starting;
+#if defined(PFX_ASAN)
+    __sanitizer_finish_switch_fiber(nullptr, &stackSwitch.callerBottom,
+                                    &stackSwitch.callerSize);
+#endif
+
+    // The exceptions can't unwind past the segment, they are thrown again
+    // on the stack of the caller.
+    try
+    {
+        stackSwitch.body(stackSwitch.argument);
+    }
+    catch (...)
+    {
+        stackSwitch.error = std::current_exception();
+    }
+
+#if defined(PFX_ASAN)
+    __sanitizer_start_switch_fiber(nullptr, stackSwitch.callerBottom,
+                                   stackSwitch.callerSize);
+#endif
+#if defined(PFX_TSAN)
+    __tsan_switch_to_fiber(stackSwitch.callerFiber, 0);
+#endif
+    setcontext(&stackSwitch.caller);
+}
+} // namespace
+#endif
+
+
+void DepthLimit::runOnNewStack(const Position &position, void (*body)(void *),
+                               void *argument)
+{
+#if defined(__linux__)
+    Segment segment;
+    std::swap(segment.memory, spare.memory);
+    if (!segment.memory)
+    {
+        void *memory = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                                MAP_STACK,
+                            -1, 0);
+        if (memory == MAP_FAILED) raise(position);
+        segment.memory = memory;
+        // An overflow past the reserve hits the guard page.
+        mprotect(memory, sysconf(_SC_PAGESIZE), PROT_NONE);
+    }
+
+    StackSwitch stackSwitch{body, argument, nullptr, {}, {}};
+    getcontext(&stackSwitch.callee);
+    stackSwitch.callee.uc_stack.ss_sp = segment.memory;
+    stackSwitch.callee.uc_stack.ss_size = segmentSize;
+    makecontext(&stackSwitch.callee, runSegment, 0);
+
+    Reserve outer = reserve;
+    reserve.start = reinterpret_cast<uintptr_t>(segment.memory);
+    reserve.size = reserveFor(segmentSize);
+    starting = &stackSwitch;
+
+#if defined(PFX_ASAN)
+    void *fakeStack = nullptr;
+    __sanitizer_start_switch_fiber(&fakeStack, segment.memory, segmentSize);
+#endif
+#if defined(PFX_TSAN)
+    stackSwitch.callerFiber = __tsan_get_current_fiber();
+    void *fiber = __tsan_create_fiber(0);
+    __tsan_switch_to_fiber(fiber, 0);
+#endif
+    swapcontext(&stackSwitch.caller, &stackSwitch.callee);
+#if defined(PFX_ASAN)
+    __sanitizer_finish_switch_fiber(fakeStack, nullptr, nullptr);
+#endif
+#if defined(PFX_TSAN)
+    __tsan_destroy_fiber(fiber);
+#endif
+
+    reserve = outer;
+    if (!spare.memory) std::swap(spare.memory, segment.memory);
+    if (stackSwitch.error) std::rethrow_exception(stackSwitch.error);
+#else
+    (void)body;
+    (void)argument;
+    raise(position);
+#endif
+}
+
+
+void DepthLimit::raise(const Position &position)
+{
+    throw error::TooDeep(position);
+}
+} // namespace pfx
@@ -0,0 +1,132 @@
+/// @file DepthLimit.hpp Contains the DepthLimit class.
+
+namespace pfx
+{
+/**
+ * Limits how deeply the evaluations can nest on the native stack.
+ *
+ * @remarks
+ *  Each group evaluation that recurses on the native stack counts one level
+ * on its thread, and raises error::TooDeep when the limit is reached. The
+ * groups the bytecode engine continues in its own loop don't count, they are
+ * kept on the heap.
+ *
+ * The recursions through commands, like the calls of a function, still nest
+ * on the native stack. When the stack of the thread is nearly full, the
+ * groups continue on a new stack segment allocated on the heap, see
+ * onNewStack(). So the depth is limited by the levels, not by the size of the
+ * stack. Where the stacks can't be switched, error::TooDeep is raised when
+ * the stack is nearly full.
+ *
+ * The bounds of the stack are read once per thread from the system. Where
+ * they can't be, a 512 KB stack is assumed below the first level.
+ */
+class DepthLimit
+{
+    static std::atomic<size_t> limit;
+    static thread_local size_t depth;
+
+    // The free stack the levels don't use, at the low end of the stack the
+    // thread runs on. The size is 0 until the stack is measured.
+    struct Reserve
+    {
+        uintptr_t start = 0;
+        size_t size = 0;
+    };
+    static thread_local Reserve reserve;
+
+    // Finds the reserve on the stack of this thread.
+    static void measure();
+
+    // Runs the body on a new stack segment.
+    static void runOnNewStack(const Position &position, void (*body)(void *),
+                              void *argument);
+
+    template <class Body>
+    static void runBody(void *body)
+    {
+        (*static_cast<Body *>(body))();
+    }
+
+public:
+    /// The limit until DepthLimit::set() is called.
+    static const size_t defaultLimit = 100000;
+
+    /**
+     * Sets the limit for all threads.
+     *
+     * @param [in] maxDepth The number of nested evaluations allowed.
+     */
+    static void set(size_t maxDepth)
+    {
+        limit.store(maxDepth, std::memory_order_relaxed);
+    }
+
+    /// @return The number of nested evaluations allowed.
+    static size_t get()
+    {
+        return limit.load(std::memory_order_relaxed);
+    }
+
+    /// @return True if the caller runs in the reserve of its stack.
+    static bool stackFull()
+    {
+        char here;
+        if (!reserve.size) measure();
+        // Out of the stack, on a coroutine for example, the difference wraps
+        // around and nothing is checked.
+        return reinterpret_cast<uintptr_t>(&here) - reserve.start <
+               reserve.size;
+    }
+
+    /**
+     * Runs an evaluation on a new stack segment, for when stackFull().
+     *
+     * @param [in] position Where the evaluation starts, for the error.
+     * @param [in] evaluate The evaluation.
+     *
+     * @return The result of the evaluation.
+     *
+     * @throw error::TooDeep When the stacks can't be switched.
+     */
+    template <class Evaluate>
+    static auto onNewStack(const Position &position, Evaluate &&evaluate)
+        -> decltype(evaluate())
+    {
+        decltype(evaluate()) result;
+        auto body = [&] { result = evaluate(); };
+        runOnNewStack(position, &runBody<decltype(body)>, &body);
+        return result;
+    }
+
+    /// Counts a nested evaluation while it's alive.
+    class Guard
+    {
+    public:
+        /**
+         * Enters a level.
+         *
+         * @param [in] position Where the evaluation starts, for the error.
+         *
+         * @throw error::TooDeep When the limit is reached or the stack is
+         * nearly full.
+         */
+        explicit Guard(const Position &position)
+        {
+            if ((depth >= get()) || stackFull()) raise(position);
+            depth++;
+        }
+
+        ~Guard()
+        {
+            depth--;
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+private:
+    [[noreturn]] static void raise(const Position &position);
+};
+} // namespace pfx
@@ -0,0 +1,62 @@
+namespace pfx
+{
+thread_local Environment *Environment::active = nullptr;
+std::atomic<uint32_t> Environment::slots(1);
+
+
+void Environment::rehash(size_t newSize)
+{
+    std::vector<Entry> old(newSize);
+    old.swap(entries);
+    size_t mask = entries.size() - 1;
+    for (Entry &entry : old)
+    {
+        if (!entry.slot) continue;
+        size_t i = home(entry.slot, mask);
+        while (entries[i].slot)
+        {
+            i = (i + 1) & mask;
+        }
+        entries[i] = std::move(entry);
+    }
+}
+
+
+Binding &Environment::bind(uint32_t slot, const Binding &shared)
+{
+    // Keep the load factor under 3/4.
+    if ((count + 1) * 4 > entries.size() * 3)
+    {
+        rehash(std::max<size_t>(8, entries.size() * 2));
+    }
+    size_t mask = entries.size() - 1;
+    size_t i = home(slot, mask);
+    while (entries[i].slot && (entries[i].slot != slot))
+    {
+        i = (i + 1) & mask;
+    }
+    Entry &entry = entries[i];
+    if (!entry.slot)
+    {
+        const Binding *inherited = parent ? parent->find(slot) : nullptr;
+        entry.binding = inherited ? *inherited : shared;
+        entry.slot = slot;
+        count++;
+    }
+    return entry.binding;
+}
+
+
+void Environment::clear()
+{
+    entries.clear();
+    count = 0;
+}
+
+
+Value Environment::evaluate(const Node &node)
+{
+    Scope scope(*this);
+    return node.evaluateValue();
+}
+} // namespace pfx
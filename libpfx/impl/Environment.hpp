@@ -0,0 +1,180 @@
+/// @file Environment.hpp Contains the Environment class.
+
+namespace pfx
+{
+/// What a name is bound to: a command or the value of a variable.
+struct Binding
+{
+    /// The command, empty while the name is a variable.
+    std::shared_ptr<Command> command;
+
+    /// The value of the variable.
+    Value value;
+};
+
+/**
+ * The bindings the names get while a compiled program runs, so the same
+ * program can be evaluated on several threads at once.
+ *
+ * @remarks
+ *  The compiled nodes don't change while the program runs, only the bindings
+ * of the command nodes do: the variables get values and the functions bind
+ * their parameters. While an environment is active on a thread, these changes
+ * go to the environment instead of the nodes, and the names are looked up in
+ * the environment first, then in the nodes. So the nodes keep the shared
+ * bindings set through the Context, and each thread sees its own changes
+ * over them.
+ *
+ * Each thread needs its own environment. The shared bindings must not change
+ * while the environments use them, set them up before starting the threads.
+ * An environment can be reused for the next evaluations on the same thread,
+ * it keeps its bindings.
+ *
+ * An environment may have a parent, that is looked up before the shared
+ * bindings. The parallel commands run their tasks in the children of the
+ * environment of the caller, so the tasks see its variables. The parent must
+ * not change while its children are used.
+ */
+class Environment
+{
+    struct Entry
+    {
+        uint32_t slot = 0; // 0 while the entry is free.
+        Binding binding;
+    };
+
+    // Open addressed table keyed by the slots of the command nodes, the size
+    // is a power of two or zero. The slots are never reused, so it holds only
+    // the bound ones, not a vector as long as the highest slot.
+    std::vector<Entry> entries;
+    size_t count = 0;
+
+    const Environment *parent = nullptr;
+
+    static size_t home(uint32_t slot, size_t mask)
+    {
+        return ((slot * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    // @return The entry of the slot in this environment, nullptr if none.
+    const Entry *lookup(uint32_t slot) const
+    {
+        if (!slot || entries.empty())
+        {
+            return nullptr;
+        }
+        size_t mask = entries.size() - 1;
+        for (size_t i = home(slot, mask);; i = (i + 1) & mask)
+        {
+            if (entries[i].slot == slot) return &entries[i];
+            if (!entries[i].slot) return nullptr;
+        }
+    }
+
+    // Rebuilds the table with the given number of entries.
+    void rehash(size_t newSize);
+
+    static thread_local Environment *active;
+
+    static std::atomic<uint32_t> slots;
+
+public:
+    Environment()
+    {
+    }
+
+    /**
+     * Creates a child environment.
+     *
+     * @param [in] parent The environment looked up before the shared
+     * bindings, nullptr for none. It must outlive the child.
+     */
+    explicit Environment(const Environment *parent) : parent(parent)
+    {
+    }
+
+    Environment(const Environment &) = delete;
+    Environment &operator=(const Environment &) = delete;
+
+    /// @return The environment active on this thread, nullptr if none is.
+    static Environment *current()
+    {
+        return active;
+    }
+
+    /**
+     * @return A slot number not given out before. The command nodes get one
+     * when they are bound in an environment the first time. 0 is never given
+     * out, it means no slot.
+     */
+    static uint32_t newSlot()
+    {
+        return slots.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param [in] slot The slot of a command node.
+     *
+     * @return The binding of the node in this environment or in its parents,
+     * nullptr if the node is not bound in them. It's valid until the next
+     * bind().
+     */
+    const Binding *find(uint32_t slot) const
+    {
+        if (const Entry *entry = lookup(slot))
+        {
+            return &entry->binding;
+        }
+        return parent ? parent->find(slot) : nullptr;
+    }
+
+    /**
+     * Gets the binding of a node to change it.
+     *
+     * @param [in] slot The slot of the node, not 0.
+     * @param [in] shared The binding of the node, copied when the node is not
+     * bound here or in the parents yet.
+     *
+     * @return The binding of the node in this environment. It's valid until
+     * the next bind().
+     */
+    Binding &bind(uint32_t slot, const Binding &shared);
+
+    /// Drops the bindings, the nodes have their shared bindings again.
+    void clear();
+
+    /**
+     * Evaluates a node in this environment.
+     *
+     * @param [in] node The node, typically the root group of a program.
+     *
+     * @return The result of the evaluation.
+     */
+    Value evaluate(const Node &node);
+
+    /// Makes an environment active on this thread while it's alive.
+    class Scope
+    {
+        Environment *outer;
+
+    public:
+        /**
+         * Activates the environment.
+         *
+         * @param [in] environment The environment.
+         */
+        explicit Scope(Environment &environment) : outer(active)
+        {
+            active = &environment;
+        }
+
+        ~Scope()
+        {
+            active = outer;
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+};
+} // namespace pfx
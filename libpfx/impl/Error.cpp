@@ -2,6 +2,6 @@ namespace pfx
 {
 std::string Error::toString() const
 {
-    return ssprintf("%s: %s", position.toString().c_str(), reason.c_str());
+    return ssprintf("%s: %s", location.c_str(), reason.c_str());
 }
 } // namespace pfx
@@ -5,17 +5,23 @@ namespace pfx
 /// Represent an exception type used within this lib.
 struct Error
 {
-    Position position;  ///< Where the exception occurred.
-    std::string reason; ///< Why it occurred.
+    Position position;    ///< Where the exception occurred.
+    std::string location; ///< The position as text, "file line:column".
+    std::string reason;   ///< Why it occurred.
 
     /**
      * Constructs an error instance.
      *
      * @param [in] position The position the error happened.
      * @param [in] reason The reason of the error.
+     *
+     * @remarks
+     *  The line and column are computed here, so the error can be reported
+     * after the source is gone.
      */
     Error(Position position, std::string reason)
-        : position(std::move(position)), reason(std::move(reason))
+        : position(position), location(position.toString()),
+          reason(std::move(reason))
     {
     }
 
@@ -35,6 +41,9 @@ namespace error
         Typename(Position p) : Error(p, message)                               \
         {                                                                      \
         }                                                                      \
+        Typename(Position p, std::string msg) : Error(p, std::move(msg))       \
+        {                                                                      \
+        }                                                                      \
     };
 
 #define DECLARE_REASON_ERROR(Typename)                                         \
@@ -53,6 +62,8 @@ DECLARE_ERROR(ClosingBraceWithoutOpeningOne,
               "You have a ')' but not the corresponding (.");
 DECLARE_ERROR(ClosingBraceExpected, "For forgot to close a '('.");
 DECLARE_ERROR(UndefinedCommand, "This command is undefined.");
+DECLARE_ERROR(MissingArgument, "This command needs more arguments.");
+DECLARE_ERROR(TooDeep, "The evaluation is nested too deeply.");
 
 DECLARE_REASON_ERROR(RuntimeError);
 DECLARE_REASON_ERROR(FailedToOpenFile);
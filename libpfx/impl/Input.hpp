@@ -6,26 +6,20 @@ namespace pfx
 class Input
 {
 private:
-    /// Can be a file stream, string stream or whatever.
-    std::unique_ptr<std::istream> inputStream;
+    /// The whole source in memory, can be a file mapping, a string or whatever.
+    SourceRef source;
 
-    const char *fn; // Filename is just stored to know what to report.
+    /// Turns the positions into lines and columns when needed.
+    std::shared_ptr<const SourceMap> map;
 
-    int column = 0; // Zero based but we add +1 when turning it to string.
-    /* The general idea is to determine the line count by counting carriage
-     * returns and line feeds. Whichever has more it determines the count of
-     * lines, this works well with \n and \r\n and \r line endings.
-     */
-
-    int crCount = 0;
-    int lfCount = 0;
-    int tabSize;
+    const char *current = nullptr; // The next byte to read.
+    const char *end = nullptr;     // One after the last byte.
 
 public:
     /// @return True if the creation failed for some reason, false otherwise.
     bool fail()
     {
-        return inputStream->fail();
+        return !source;
     }
 
     /**
@@ -36,10 +30,24 @@ public:
      * @param [in] tabSize The number of spaces in a tab stop.
      */
     Input(const char *filename, const std::string &source, int tabSize = 4)
-        : tabSize(tabSize)
+        : Input(filename, createStringSource(source), tabSize)
+    {
+    }
+
+    /**
+     * Creates the input from an already loaded source buffer.
+     *
+     * @param [in] filename The name of the text file to show. It must outlive
+     * the positions reported.
+     * @param [in] source The source buffer to read.
+     * @param [in] tabSize The number of spaces in a tab stop.
+     */
+    Input(const char *filename, SourceRef source, int tabSize = 4)
+        : source(source),
+          map(std::make_shared<SourceMap>(filename, source, tabSize))
     {
-        inputStream = std::make_unique<std::stringstream>(source);
-        fn = filename;
+        current = this->source->begin;
+        end = this->source->end;
     }
 
     /**
@@ -47,41 +55,98 @@ public:
      *
      * @param [in] file The file to open.
      * @param [in] tabSize The number of spaces in a tab stop.
+     *
+     * @remarks Regular files are memory mapped, not read.
      */
-    Input(const char *file, int tabSize = 4);
+    Input(const char *file, int tabSize = 4)
+        : Input(file, openFileSource(file), tabSize)
+    {
+    }
 
     /**
      * @return True if we are at the end of file.
-     *
-     * @remarks It just calls the underlying stream's eof() method.
      */
     bool eof()
     {
-        return inputStream->eof();
+        return current == end;
     }
 
     /**
-     * @return The next character in the input.
-     *
-     * @remarks It just calls the underlying stream's peek() method.
+     * @return The next character in the input, EOF at the end.
      */
     int peek()
     {
-        return inputStream->peek();
+        return current != end ? static_cast<unsigned char>(*current) : EOF;
+    }
+
+    /**
+     * @return The next character and consume it. EOF at the end.
+     */
+    int get()
+    {
+        return current != end ? static_cast<unsigned char>(*current++) : EOF;
+    }
+
+    /**
+     * @return The source buffer the input reads from.
+     */
+    const SourceRef &getSource() const
+    {
+        return source;
     }
 
     /**
-     * @return The next character and consume it.
+     * @return Pointer to the next unread byte in the source buffer.
      */
-    int get();
+    const char *data() const
+    {
+        return current;
+    }
+
+    /**
+     * @return Pointer one after the last byte of the source buffer.
+     */
+    const char *dataEnd() const
+    {
+        return end;
+    }
+
+    /**
+     * Consumes all bytes up to the given pointer, just like calling get()
+     * for each of them.
+     *
+     * @param [in] to Pointer into the source buffer, between data() and
+     * dataEnd().
+     */
+    void advance(const char *to)
+    {
+        current = to;
+    }
+
+    /**
+     * @return The source map positions of this input refer to.
+     */
+    const std::shared_ptr<const SourceMap> &getSourceMap() const
+    {
+        return map;
+    }
+
+    /**
+     * @param [in] p Pointer into the source buffer.
+     *
+     * @return The character position of the pointed byte.
+     */
+    Position getPosition(const char *p) const
+    {
+        return Position{map.get(), static_cast<size_t>(p - source->begin)};
+    }
 
     /**
      * @return The current character position.
      */
-    Position getPosition()
+    Position getPosition() const
     {
-        return Position{fn, column + 1,
-                        crCount > lfCount ? crCount + 1 : lfCount + 1};
+        return getPosition(current);
     }
 };
-} // namespace pfx
\ No newline at end of file
+} // namespace pfx
@@ -2,6 +2,31 @@ namespace pfx
 {
 
 
+Value Node::evaluateValue() const
+{
+    ArgIterator tmp;
+    return evaluateValue(tmp);
+}
+
+
+Value Node::evaluateValue(ArgIterator &iterator) const
+{
+    return evaluate(iterator);
+}
+
+
+Value IntegerNode::evaluateValue(ArgIterator &) const
+{
+    return Value(value);
+}
+
+
+Value FloatNode::evaluateValue(ArgIterator &) const
+{
+    return Value(value);
+}
+
+
 std::string IntegerNode::toString() const
 {
     return ssprintf("%d", value);
@@ -14,18 +39,43 @@ std::string FloatNode::toString() const
 }
 
 
+/// A group being walked without recursion, and the index of its next child.
+struct GroupWalk
+{
+    const GroupNode *group;
+    size_t next;
+};
+
+
 void GroupNode::dump(int indent) const
 {
+    // The nested groups are walked on a heap stack, they can be deep.
+    std::vector<GroupWalk> walks{GroupWalk{this, 0}};
     printf("(\n");
-    for (unsigned i = 0; i < nodes.size(); i++)
+    while (!walks.empty())
     {
-        const NodeInfo &current = nodes[i];
-        dumpIndent(indent + 1);
-        current.node->dump(indent + 1);
+        GroupWalk &walk = walks.back();
+        int level = indent + int(walks.size()) - 1;
+        if (walk.next == walk.group->nodes.size())
+        {
+            dumpIndent(level);
+            printf(")");
+            walks.pop_back();
+            if (!walks.empty()) printf("\n");
+            continue;
+        }
+
+        const Node *child = walk.group->nodes[walk.next++].node.get();
+        dumpIndent(level + 1);
+        if (auto *group = child->as<GroupNode>())
+        {
+            printf("(\n");
+            walks.push_back(GroupWalk{group, 0});
+            continue;
+        }
+        child->dump(level + 1);
         printf("\n");
     }
-    dumpIndent(indent);
-    printf(")");
 }
 
 
@@ -34,32 +84,106 @@ std::string GroupNode::toString() const
     std::string str;
 
     /* Concatenate the string representation of all child nodes without
-     * evaluation.*/
-    for (auto childNode : nodes)
+     * evaluation. The nested groups are walked on a heap stack.*/
+    std::vector<GroupWalk> walks{GroupWalk{this, 0}};
+    while (!walks.empty())
     {
-        str += childNode.node->toString();
+        GroupWalk &walk = walks.back();
+        if (walk.next == walk.group->nodes.size())
+        {
+            walks.pop_back();
+            continue;
+        }
+
+        const Node *child = walk.group->nodes[walk.next++].node.get();
+        if (auto *group = child->as<GroupNode>())
+        {
+            walks.push_back(GroupWalk{group, 0});
+        }
+        else
+        {
+            str += child->toString();
+        }
     }
     return str;
 }
 
 
-NodeRef NullNode::instance = std::make_shared<NullNode>();
+/// Moves the children that are groups only referenced from here to dying.
+static void takeLastGroups(std::pmr::vector<NodeInfo> &nodes,
+                           std::vector<NodeRef> &dying)
+{
+    for (NodeInfo &child : nodes)
+    {
+        if (child.node && (child.node->getRefCount() == 1) &&
+            child.node->as<GroupNode>())
+        {
+            dying.push_back(std::move(child.node));
+        }
+    }
+}
 
 
-NodeRef CommandNode::evaluate(ArgIterator &hIter) const
+GroupNode::~GroupNode()
 {
-    return command->execute(hIter);
+    // Each group is released after its nested groups are taken, so none of
+    // them recurses.
+    std::vector<NodeRef> dying;
+    takeLastGroups(nodes, dying);
+    while (!dying.empty())
+    {
+        NodeRef group = std::move(dying.back());
+        dying.pop_back();
+        takeLastGroups(group->as<GroupNode>()->nodes, dying);
+    }
 }
 
 
-NodeRef GroupNode::evaluate(ArgIterator &) const
+/// @return Where the group starts, for the errors.
+static Position startOf(const GroupNode &group)
+{
+    return group.nodes.empty() ? Position() : group.nodes[0].start;
+}
+
+
+NodeRef NullNode::instance = makeNode<NullNode>();
+
+
+const NodeRef *smallIntegers()
 {
+    // Created on first use, so it works during static initialization too.
+    static const std::vector<NodeRef> nodes = [] {
+        std::vector<NodeRef> tmp;
+        for (int i = smallIntegerMin; i <= smallIntegerMax; i++)
+        {
+            tmp.push_back(makeNode<IntegerNode>(i));
+        }
+        return tmp;
+    }();
+
+    return nodes.data();
+}
+
+
+NodeRef GroupNode::evaluate(ArgIterator &iterator) const
+{
+    if (bytecode)
+    {
+        return evaluateValue(iterator).toNode();
+    }
+
+    if (DepthLimit::stackFull())
+    {
+        return DepthLimit::onNewStack(startOf(*this),
+                                      [&] { return evaluate(iterator); });
+    }
+    DepthLimit::Guard guard(startOf(*this));
     NodeRef resultNode = NullNode::instance;
 
     /* Evaluate each node, but pass the iterator to the nodes just in case
      they would like to fetch more nodes.*/
     ArgIterator iter(nodes.begin(), nodes.end());
-    while (!iter.ended())
+    while (!iter.ended() && !TailCall::pending())
     {
         resultNode = iter.evaluateNext();
     }
@@ -67,18 +191,178 @@ NodeRef GroupNode::evaluate(ArgIterator &) const
 }
 
 
-std::shared_ptr<GroupNode> GroupNode::evaluateAll() const
+Value GroupNode::evaluateValue(ArgIterator &) const
 {
-    auto newGroupNode = std::make_shared<GroupNode>();
+    // The children may have been replaced since the bytecode is compiled.
+    if (bytecode && bytecode->matches(*this))
+    {
+        return bytecode->run(*this);
+    }
+
+    if (DepthLimit::stackFull())
+    {
+        return DepthLimit::onNewStack(startOf(*this),
+                                      [&] { return evaluateValue(); });
+    }
+    DepthLimit::Guard guard(startOf(*this));
+    Value result;
+
+    // A requested tail call ends the group.
+    ArgIterator iter(nodes.begin(), nodes.end());
+    while (!iter.ended() && !TailCall::pending())
+    {
+        result = iter.evaluateNextValue();
+    }
+    return result;
+}
+
+
+GroupRef GroupNode::evaluateAll() const
+{
+    if (DepthLimit::stackFull())
+    {
+        return DepthLimit::onNewStack(startOf(*this),
+                                      [&] { return evaluateAll(); });
+    }
+    DepthLimit::Guard guard(startOf(*this));
+    auto newGroupNode = makeNode<GroupNode>();
 
     /* Evaluate each node, but pass the iterator to the nodes just in case
      they would like to fetch more nodes.*/
     ArgIterator iter(nodes.begin(), nodes.end());
-    while (!iter.ended())
+    while (!iter.ended() && !TailCall::pending())
     {
         newGroupNode->nodes.push_back(iter.evaluateNext());
     }
     return newGroupNode;
 }
 
+
+/**
+ * Finds where the expression starting at a child ends: the node and the
+ * arguments its command reads, according to the signatures.
+ *
+ * @return The index after the expression, npos if a command reads its
+ * arguments itself, so the end is unknown.
+ */
+static size_t expressionEnd(const std::pmr::vector<NodeInfo> &nodes,
+                            size_t start)
+{
+    // The calls waiting for their arguments, the nested ones on the top.
+    struct Reading
+    {
+        const std::vector<ArgMode> *modes;
+        size_t next;
+    };
+    std::vector<Reading> calls;
+
+    size_t i = start;
+    for (;;)
+    {
+        // An evaluated node, the missing ones at the end are null.
+        if (i < nodes.size())
+        {
+            const Node *node = nodes[i++].node.get();
+            auto *commandNode = node->as<CommandNode>();
+            const Command *command =
+                commandNode ? commandNode->getCommand().get() : nullptr;
+            if (command)
+            {
+                const Signature *signature = command->getSignature();
+                if (!signature) return std::string::npos;
+                if (!signature->args.empty())
+                {
+                    calls.push_back(Reading{&signature->args, 0});
+                }
+            }
+        }
+
+        // Skip the fetched arguments until one is evaluated.
+        for (;;)
+        {
+            if (calls.empty()) return i;
+            Reading &call = calls.back();
+            if (call.next == call.modes->size())
+            {
+                calls.pop_back();
+                continue;
+            }
+            if ((*call.modes)[call.next++] == ArgMode::Evaluate) break;
+            if (i < nodes.size()) i++;
+        }
+    }
+}
+
+
+GroupRef GroupNode::evaluateAll(ThreadPool &pool) const
+{
+    // Split the children into the expressions evaluateAll() would evaluate.
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < nodes.size();)
+    {
+        starts.push_back(i);
+        i = expressionEnd(nodes, i);
+        if (i == std::string::npos) return evaluateAll();
+    }
+    if ((starts.size() < 2) || !pool.size()) return evaluateAll();
+    PurityCheck check;
+    if (!check.isPure(*this)) return evaluateAll();
+
+    DepthLimit::Guard guard(startOf(*this));
+    size_t count = starts.size();
+    starts.push_back(nodes.size());
+    std::vector<NodeRef> results(count);
+
+    // A few chunks for each worker, so the faster ones can steal the rest.
+    size_t chunkCount = std::min(count, pool.size() * 8 + 1);
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    const Environment *caller = Environment::current();
+    pool.run(chunkCount, [&](size_t chunk) {
+        // The bindings the expressions change are their own.
+        Environment environment(caller);
+        Environment::Scope scope(environment);
+        size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; i++)
+        {
+            ArgIterator iter(nodes.begin() + starts[i],
+                             nodes.begin() + starts[i + 1]);
+            results[i] = iter.evaluateNext();
+        }
+    });
+
+    auto newGroupNode = makeNode<GroupNode>();
+    newGroupNode->nodes.reserve(count);
+    for (NodeRef &result : results)
+    {
+        newGroupNode->nodes.push_back(std::move(result));
+    }
+    return newGroupNode;
+}
+
+
+void GroupNode::compileBytecode()
+{
+    // The nested groups and the linked calls are walked on a heap stack, they
+    // can be deep.
+    std::vector<const std::pmr::vector<NodeInfo> *> lists{&nodes};
+    while (!lists.empty())
+    {
+        const std::pmr::vector<NodeInfo> *children = lists.back();
+        lists.pop_back();
+        for (const NodeInfo &child : *children)
+        {
+            if (GroupNode *group = child.node->as<GroupNode>())
+            {
+                group->bytecode = std::make_shared<const Bytecode>(*group);
+                lists.push_back(&group->nodes);
+            }
+            else if (CallNode *call = child.node->as<CallNode>())
+            {
+                lists.push_back(&call->args);
+            }
+        }
+    }
+    bytecode = std::make_shared<const Bytecode>(*this);
+}
+
 } // namespace pfx
\ No newline at end of file
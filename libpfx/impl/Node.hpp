@@ -3,12 +3,26 @@
 namespace pfx
 {
 /// Defines a node, the basic building block of the language.
-class Node : public std::enable_shared_from_this<Node>
+class Node
 {
     // Owned via references, do not copy.
     Node(const Node &) = delete;
     Node &operator=(const Node &) = delete;
 
+    // The number of references to this node.
+    mutable RefCounter refCount;
+
+    // The arena the node is allocated from, null if it's on the heap.
+    Arena *arena = nullptr;
+
+    // The type of the class of the node, the casts compare it. Only the node
+    // classes of the library set it, the others may report any type.
+    const NodeType tag = NodeType::Null;
+    const bool tagged = false;
+
+    template <class T, class... Args>
+    friend Ref<T> makeNodeIn(Arena *arena, Args &&... args);
+
 protected:
     /** Used internally to dump indents.
      *
@@ -19,6 +33,15 @@ protected:
         printf("%*s", indent * 4, "");
     }
 
+    /**
+     * Constructor of the node classes of the library.
+     *
+     * @param [in] type The static type of the class, see as().
+     */
+    explicit Node(NodeType type) : tag(type), tagged(true)
+    {
+    }
+
 public:
     /// Default constructor does nothing.
     Node()
@@ -30,6 +53,36 @@ public:
     {
     }
 
+    /// Adds a reference to the node.
+    void addRef() const
+    {
+        refCount.increment();
+    }
+
+    /// Removes a reference, the node is destroyed when it was the last one.
+    void release() const
+    {
+        if (!refCount.decrement()) return;
+
+        if (arena)
+        {
+            // The memory is owned by the arena.
+            Arena *owner = arena;
+            this->~Node();
+            owner->release();
+        }
+        else
+        {
+            delete this;
+        }
+    }
+
+    /// @return The number of references to the node.
+    int getRefCount() const
+    {
+        return refCount.get();
+    }
+
     /**
      * Dumps the contents of the node, for debugging purposes.
      *
@@ -71,9 +124,31 @@ public:
     virtual NodeRef evaluate(ArgIterator &iterator) const
     {
         (void)iterator;
-        return std::const_pointer_cast<Node>(shared_from_this());
+        return NodeRef(const_cast<Node *>(this));
     }
 
+    /**
+     * Node evaluation without iterators, producing a value.
+     *
+     * @return The result of the evaluation.
+     */
+    Value evaluateValue() const;
+
+    /**
+     * Evaluates a node, producing a value.
+     *
+     * @param [in] iterator An iterator the implementation may use to read
+     * further arguments.
+     *
+     * @return The result of the evaluation.
+     *
+     * @remarks
+     *  The default behavior is wrapping the result of evaluate(). Integers and
+     * floats, and commands that implement Command::call() return their result
+     * without allocating a node for it.
+     */
+    virtual Value evaluateValue(ArgIterator &iterator) const;
+
 
     /**
      * @return string value from the node. The behavior is implementation
@@ -98,31 +173,52 @@ public:
      */
     virtual NodeType getType() const = 0;
 
+    /**
+     * Downcasts the node to one of the node classes of the library.
+     *
+     * @return The node as T, nullptr if it's not a T.
+     *
+     * @remarks
+     *  It compares the type tag of the node with T::type, so it works without
+     * RTTI.
+     */
+    template <class T>
+    T *as()
+    {
+        return tagged && (tag == T::type) ? static_cast<T *>(this) : nullptr;
+    }
+
+    /// @copydoc as()
+    template <class T>
+    const T *as() const
+    {
+        return tagged && (tag == T::type) ? static_cast<const T *>(this)
+                                          : nullptr;
+    }
+
     /**
      * @returns the current node downcast as group node. Empty reference is
      * returns if the node is not a group node. You can use the ! operator to
      * determine that.
      */
-    GroupRef asGroup()
-    {
-        return std::dynamic_pointer_cast<GroupNode>(shared_from_this());
-    }
+    GroupRef asGroup();
 
     /**
      * @returns the current node downcast as a command node. Empty reference is
      * returned if the node is not a group node. You can use the ! operator to
      * determine that.
      */
-    CommandRef asCommand()
-    {
-        return std::dynamic_pointer_cast<CommandNode>(shared_from_this());
-    }
+    CommandRef asCommand();
 };
 
 /// This node represents an immutable integer value.
 struct IntegerNode : Node
 {
     using Node::evaluate;
+    using Node::evaluateValue;
+
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::Integer;
 
     /// The stored value.
     const int value;
@@ -132,7 +228,7 @@ struct IntegerNode : Node
      *
      * @param [in] value The value to store.
      */
-    IntegerNode(int value) : value(value)
+    IntegerNode(int value) : Node(type), value(value)
     {
     }
 
@@ -175,12 +271,19 @@ struct IntegerNode : Node
     {
         return NodeType::Integer;
     };
+
+    /// @return The value itself, without allocation.
+    Value evaluateValue(ArgIterator &iterator) const override;
 };
 
 /// This node represents an immutable floating point value
 struct FloatNode : Node
 {
     using Node::evaluate;
+    using Node::evaluateValue;
+
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::FloatingPoint;
 
     /// The stored value itself.
     const double value;
@@ -190,7 +293,7 @@ struct FloatNode : Node
      *
      * @param [in] value The value to store.
      */
-    FloatNode(double value) : value(value)
+    FloatNode(double value) : Node(type), value(value)
     {
     }
 
@@ -229,96 +332,56 @@ struct FloatNode : Node
     {
         return NodeType::FloatingPoint;
     };
+
+    /// @return The value itself, without allocation.
+    Value evaluateValue(ArgIterator &iterator) const override;
 };
 
-/// Represents an user defined command.
-struct CommandNode : Node
+/// Represents a string value.
+struct StringNode : Node
 {
     using Node::evaluate;
 
-    /// Reference to the command.
-    std::shared_ptr<Command> command;
-
-    /// The name of the command. This is stored during the parsing.
-    std::string prettyName;
+private:
+    /// The owned copy of the value, unused when the value is borrowed.
+    const std::string storage;
 
-    /**
-     * Constructs a command node for the given command.
-     *
-     * @param [in] command The command this node represents.
-     */
-    CommandNode(std::shared_ptr<Command> command) : command(std::move(command))
-    {
-    }
-
-    /**
-     * Constructs a command node for the given command.
-     *
-     * @param [in] command The command this node represents.
-     * @param [in] name The name of the command refer to.
-     */
-    CommandNode(std::shared_ptr<Command> command, std::string name)
-        : CommandNode(std::move(command))
-    {
-        prettyName = std::move(name);
-    }
+    /// Keeps the source alive when the value is borrowed from it.
+    const SourceRef source;
 
-    void dump(int /*indent*/) const override
-    {
-        printf("Command: %s", prettyName.c_str());
-    }
+public:
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::String;
 
-    std::string toString() const override
-    {
-        return prettyName;
-    }
-    int toInteger() const override
-    {
-        return 0;
-    }
-    double toDouble() const override
-    {
-        return 0.0;
-    }
+    /// The stored value.
+    const std::string_view value;
 
     /**
-     * Evaluates the node by running the passed in command.
-     *
-     * @param [in,out] iterator The argument iterator the command use the fetch
-     * more arguments.
+     * Creates string node.
      *
-     * @return The result of the command.
+     * @param [in] value The string value to store.
      */
-    NodeRef evaluate(ArgIterator &iterator) const override;
-
-    /// @return NodeType::Command
-    NodeType getType() const override
+    StringNode(std::string value)
+        : Node(type), storage(std::move(value)), value(storage)
     {
-        return NodeType::Command;
-    };
-};
-
-/// Represents a string value.
-struct StringNode : Node
-{
-    using Node::evaluate;
-
-    /// The stored value.
-    const std::string value;
+    }
 
     /**
-     * Creates string node.
+     * Creates a string node that borrows its value from a source buffer
+     * instead of copying it.
      *
-     * @param [in] value The string value to store.
+     * @param [in] value The slice of the source buffer.
+     * @param [in] source The buffer the slice points into.
      */
-    StringNode(std::string value) : value(std::move(value))
+    StringNode(std::string_view value, SourceRef source)
+        : Node(type), source(std::move(source)), value(value)
     {
     }
 
     /// @return The stored value.
     std::string toString() const override
     {
-        return value;
+        return std::string(value);
     }
 
     /// @return the value converted to integer using strtol.
@@ -335,7 +398,8 @@ struct StringNode : Node
 
     void dump(int /*indent*/) const override
     {
-        printf("Quoted string: %s", value.c_str());
+        printf("Quoted string: %.*s", static_cast<int>(value.size()),
+               value.data());
     }
 
     /// @return NodeType::String
@@ -349,8 +413,37 @@ struct StringNode : Node
 struct GroupNode : Node
 {
     using Node::evaluate;
+    using Node::evaluateValue;
+
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::Group;
+
     /// Contains references to nodes and their metadata.
-    std::vector<NodeInfo> nodes;
+    std::pmr::vector<NodeInfo> nodes;
+
+    /// Keeps the source map of the positions alive, set for compiled groups.
+    std::shared_ptr<const SourceMap> source;
+
+    /// The bytecode of the children, if it's compiled. See compileBytecode().
+    std::shared_ptr<const Bytecode> bytecode;
+
+    /// Creates an empty group, the child list is on the heap.
+    GroupNode() : Node(type)
+    {
+    }
+
+    /**
+     * Creates an empty group.
+     *
+     * @param [in] resource The memory the child list is allocated from.
+     */
+    explicit GroupNode(std::pmr::memory_resource *resource)
+        : Node(type), nodes(resource)
+    {
+    }
+
+    /// Releases the nested groups without recursion, they can be deep.
+    ~GroupNode() override;
 
     /**
      * Gets the string representation of all child nodes and concatenate them.
@@ -389,6 +482,13 @@ struct GroupNode : Node
      */
     NodeRef evaluate(ArgIterator &) const override;
 
+    /**
+     * Evaluates each node like evaluate(), but works with values.
+     *
+     * @return The value of the last evaluation.
+     */
+    Value evaluateValue(ArgIterator &) const override;
+
     /**
      * Evaluate all nodes in the group.
      *
@@ -399,7 +499,40 @@ struct GroupNode : Node
      * This works similarly to the evaluate, except that all evaluation results
      * are kept.
      */
-    std::shared_ptr<GroupNode> evaluateAll() const;
+    GroupRef evaluateAll() const;
+
+    /**
+     * Evaluates the children like evaluateAll(), but in parallel when it's
+     * safe.
+     *
+     * @param [in,out] pool The threads to evaluate on.
+     *
+     * @return A new group node containing the evaluation result of each
+     * evaluation, in order.
+     *
+     * @throw ... The error of the first expression that fails, like in
+     * sequence.
+     *
+     * @remarks
+     *  The children are split into the expressions evaluateAll() would
+     * evaluate one by one, a command and its arguments, and those run on the
+     * pool. Each runs in a child of the active environment, see Environment.
+     * It's only done when all the commands reachable from the children are
+     * pure (see PurityCheck) and read their arguments according to a
+     * signature, so the splits are known. Otherwise the children are
+     * evaluated in sequence.
+     */
+    GroupRef evaluateAll(ThreadPool &pool) const;
+
+    /**
+     * Compiles the bytecode of this group and its child groups. From then on
+     * they are evaluated by the bytecode engine.
+     *
+     * @remarks
+     *  The bytecode is a snapshot of the children. A group whose children are
+     * replaced is evaluated node by node until it's compiled again.
+     */
+    void compileBytecode();
 
     /**
      * @return The iterator for child node evaluation and iteration.
@@ -423,6 +556,14 @@ struct NullNode : Node
 {
     using Node::evaluate;
 
+    /// The type of the class, for Node::as().
+    static constexpr NodeType type = NodeType::Null;
+
+    /// Creates a null node, use the instance instead.
+    NullNode() : Node(type)
+    {
+    }
+
     /// @return the string "null".
     std::string toString() const override
     {
@@ -456,16 +597,79 @@ struct NullNode : Node
     };
 };
 
+inline GroupRef Node::asGroup()
+{
+    return GroupRef(as<GroupNode>());
+}
+
+/**
+ * Creates a node on the heap.
+ *
+ * @param [in] args The arguments of the node's constructor.
+ *
+ * @return Reference to the new node.
+ */
+template <class T, class... Args> Ref<T> makeNode(Args &&... args)
+{
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+/**
+ * Creates a node in an arena.
+ *
+ * @param [in] arena The arena to allocate from. If it's null, the node is
+ * created on the heap.
+ * @param [in] args The arguments of the node's constructor.
+ *
+ * @return Reference to the new node.
+ *
+ * @remarks The node keeps a reference to the arena.
+ */
+template <class T, class... Args>
+Ref<T> makeNodeIn(Arena *arena, Args &&... args)
+{
+    if (!arena)
+    {
+        return makeNode<T>(std::forward<Args>(args)...);
+    }
+
+    void *memory = arena->allocate(sizeof(T), alignof(T));
+    T *node = new (memory) T(std::forward<Args>(args)...);
+    node->arena = arena;
+    arena->addRef();
+    return Ref<T>(node);
+}
+
+/// The smallest integer that has a preallocated node.
+const int smallIntegerMin = -128;
+
+/// The largest integer that has a preallocated node.
+const int smallIntegerMax = 1023;
+
+/**
+ * @return The array of preallocated integer nodes from smallIntegerMin to
+ * smallIntegerMax.
+ */
+const NodeRef *smallIntegers();
+
 /**
  * creates an integer node.
  *
  * @param [in] value The value the node represents.
  *
  * @return The node.
+ *
+ * @remarks
+ *  Small integers are not allocated, a shared preallocated node is returned
+ * for them.
  */
 inline NodeRef createInteger(int value)
 {
-    return std::make_shared<IntegerNode>(value);
+    if ((smallIntegerMin <= value) && (value <= smallIntegerMax))
+    {
+        return smallIntegers()[value - smallIntegerMin];
+    }
+    return makeNode<IntegerNode>(value);
 }
 
 /**
@@ -477,7 +681,7 @@ inline NodeRef createInteger(int value)
  */
 inline NodeRef createFloat(double value)
 {
-    return std::make_shared<FloatNode>(value);
+    return makeNode<FloatNode>(value);
 }
 
 /**
@@ -489,7 +693,7 @@ inline NodeRef createFloat(double value)
  */
 inline NodeRef createString(std::string value)
 {
-    return std::make_shared<StringNode>(value);
+    return makeNode<StringNode>(std::move(value));
 }
 
 /**
@@ -499,19 +703,7 @@ inline NodeRef createString(std::string value)
  */
 inline GroupRef createGroup()
 {
-    return std::make_shared<GroupNode>();
-}
-
-/**
- * creates a command node.
- *
- * @param [in] command The command callback it represents.
- *
- * @return The node.
- */
-inline CommandRef createCommand(CommandCallbackRef command)
-{
-    return std::make_shared<CommandNode>(command);
+    return makeNode<GroupNode>();
 }
 
 } // namespace pfx
\ No newline at end of file
@@ -7,7 +7,7 @@ namespace pfx
  * @remarks
  * The reason this structure exists, is that the same node may exist in multiple
  * places in the source (as in command nodes). So there must be a way to specify
- * their positions separately.
+ * their positions and their caches separately.
  */
 struct NodeInfo
 {
@@ -20,6 +20,9 @@ struct NodeInfo
     /// The reference to the pointed node.
     NodeRef node;
 
+    /// The cache of the commands called from here.
+    CacheSlot cache;
+
     /**
      * Simple constructor for nodes that created on the fly.
      *
@@ -12,6 +12,7 @@ enum class NodeType
     String,        ///< String literal
     Command,       ///< Command
     Group,         ///< Group of nodes
+    Call,          ///< Command call with its arguments linked
     Null           ///< Unknown node
 };
 }
\ No newline at end of file
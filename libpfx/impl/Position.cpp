@@ -1,13 +1,40 @@
 namespace pfx
 {
 
+const char *Position::fileName() const
+{
+    return map ? map->getFileName() : "(unknown)";
+}
+
+
+int Position::line() const
+{
+    int line = 0;
+    int column = 0;
+    if (map) map->resolve(offset, line, column);
+    return line;
+}
+
+
+int Position::column() const
+{
+    int line = 0;
+    int column = 0;
+    if (map) map->resolve(offset, line, column);
+    return column;
+}
+
+
 std::string Position::toString() const
 {
-    return ssprintf("%s %d:%d", fn, line, column);
+    int line = 0;
+    int column = 0;
+    if (map) map->resolve(offset, line, column);
+    return ssprintf("%s %d:%d", fileName(), line, column);
 }
 
 
-void Position::raiseErrorHere(std::string errorMsg)
+void Position::raiseErrorHere(std::string errorMsg) const
 {
     throw error::RuntimeError(*this, std::move(errorMsg));
 }
@@ -2,12 +2,27 @@
 
 namespace pfx
 {
-/// Represents a character position in the source code.
+/**
+ * Represents a character position in the source code.
+ *
+ * @remarks
+ * It's just a byte offset, the line and column are computed on demand. The
+ * source map must be alive when they are computed. Compiled group nodes keep
+ * their source map alive.
+ */
 struct Position
 {
-    const char *fn; ///< The file the position is in
-    int column;     ///< The column in the file.
-    int line;       ///< The line in the file.
+    const SourceMap *map = nullptr; ///< The source the position is in.
+    size_t offset = 0;              ///< The byte offset in the source.
+
+    /// @return The file the position is in.
+    const char *fileName() const;
+
+    /// @return The one based line in the file. 0 if unknown.
+    int line() const;
+
+    /// @return The one based column in the file. 0 if unknown.
+    int column() const;
 
     /// @return A string representation of this structure.
     std::string toString() const;
@@ -19,7 +34,7 @@ struct Position
      *
      * @throw error::RuntimeError This is the exception thrown.
      */
-    void raiseErrorHere(std::string errorMessage);
+    void raiseErrorHere(std::string errorMessage) const;
 };
 
-} // namespace pfx
\ No newline at end of file
+} // namespace pfx
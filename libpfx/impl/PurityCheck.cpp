@@ -0,0 +1,48 @@
+namespace pfx
+{
+bool PurityCheck::isPure(const Node &root)
+{
+    // The groups can be deep, they are walked on a heap stack.
+    std::vector<const Node *> pending{&root};
+    while (!pending.empty())
+    {
+        const Node *node = pending.back();
+        pending.pop_back();
+        if (!visited.insert(node).second) continue;
+
+        if (auto *group = node->as<GroupNode>())
+        {
+            for (const NodeInfo &child : group->nodes)
+            {
+                pending.push_back(child.node.get());
+            }
+        }
+        else if (auto *call = node->as<CallNode>())
+        {
+            pending.push_back(call->target.get());
+            for (const NodeInfo &arg : call->args)
+            {
+                pending.push_back(arg.node.get());
+            }
+        }
+        else if (auto *command = node->as<CommandNode>())
+        {
+            const Binding &binding = command->getBinding();
+            if (binding.command)
+            {
+                if (!binding.command->isPure(*this)) return false;
+            }
+            else if (const Node *value = binding.value.getNode())
+            {
+                pending.push_back(value);
+            }
+        }
+        else if (!node->as<IntegerNode>() && !node->as<FloatNode>() &&
+                 !node->as<StringNode>() && !node->as<NullNode>())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace pfx
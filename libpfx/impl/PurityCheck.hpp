@@ -0,0 +1,31 @@
+/// @file PurityCheck.hpp Contains the PurityCheck class.
+
+namespace pfx
+{
+/**
+ * Checks if evaluating nodes can only run pure commands, see
+ * Command::isPure().
+ *
+ * @remarks
+ *  The check walks the nodes that can be evaluated: the children of the
+ * groups, the arguments of the linked calls, the commands the names are bound
+ * to, and the nodes in the values of the variables. The commands check the
+ * nodes they run in turn, like a function checks its body. Each node is
+ * checked once, so the recursive functions are fine.
+ *
+ * Nodes of unknown classes are not pure, since their evaluation is unknown.
+ * The result holds while the bindings don't change.
+ */
+class PurityCheck
+{
+    std::unordered_set<const Node *> visited;
+
+public:
+    /**
+     * @param [in] node The node to check.
+     *
+     * @return True if evaluating the node can only run pure commands.
+     */
+    bool isPure(const Node &node);
+};
+} // namespace pfx
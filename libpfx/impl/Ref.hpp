@@ -0,0 +1,236 @@
+/// @file Ref.hpp Contains the intrusive reference counting primitives.
+
+namespace pfx
+{
+/**
+ * Reference counter stored inside the counted object.
+ *
+ * @remarks
+ *  It's atomic by default. Define PFX_SINGLE_THREADED (for the library and its
+ * clients alike) to get plain integer counting when the nodes are never
+ * shared between threads.
+ */
+class RefCounter
+{
+#ifdef PFX_SINGLE_THREADED
+    int count = 0;
+
+public:
+    /// Adds a reference.
+    void increment()
+    {
+        count++;
+    }
+
+    /// @return True if the last reference is removed.
+    bool decrement()
+    {
+        return --count == 0;
+    }
+
+    /// @return The number of references.
+    int get() const
+    {
+        return count;
+    }
+#else
+    std::atomic<int> count{0};
+
+public:
+    /// Adds a reference.
+    void increment()
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @return True if the last reference is removed.
+    bool decrement()
+    {
+        return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    /// @return The number of references.
+    int get() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+#endif
+};
+
+/**
+ * Reference to an object that counts its references itself.
+ *
+ * @remarks
+ *  The object must have addRef() and release() methods. The interface follows
+ * std::shared_ptr, so it can be used the same way.
+ */
+template <class T> class Ref
+{
+    template <class U> friend class Ref;
+
+    T *ptr = nullptr;
+
+public:
+    /// The type of the referenced object.
+    typedef T element_type;
+
+    /// Creates an empty reference.
+    Ref()
+    {
+    }
+
+    /// Creates an empty reference.
+    Ref(std::nullptr_t)
+    {
+    }
+
+    /**
+     * Creates a new reference to the object.
+     *
+     * @param [in] p The object to refer to.
+     */
+    explicit Ref(T *p) : ptr(p)
+    {
+        if (ptr) ptr->addRef();
+    }
+
+    /**
+     * Copies the reference.
+     *
+     * @param [in] other The reference to copy.
+     */
+    Ref(const Ref &other) : Ref(other.ptr)
+    {
+    }
+
+    /**
+     * Copies a reference of a derived type.
+     *
+     * @param [in] other The reference to copy.
+     */
+    template <class U,
+              class = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+    Ref(const Ref<U> &other) : Ref(other.ptr)
+    {
+    }
+
+    /**
+     * Takes over the reference.
+     *
+     * @param [in,out] other The reference to take, it becomes empty.
+     */
+    Ref(Ref &&other) noexcept : ptr(other.ptr)
+    {
+        other.ptr = nullptr;
+    }
+
+    /**
+     * Takes over the reference of a derived type.
+     *
+     * @param [in,out] other The reference to take, it becomes empty.
+     */
+    template <class U,
+              class = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+    Ref(Ref<U> &&other) noexcept : ptr(other.ptr)
+    {
+        other.ptr = nullptr;
+    }
+
+    /// Releases the reference.
+    ~Ref()
+    {
+        if (ptr) ptr->release();
+    }
+
+    /**
+     * Assigns a reference.
+     *
+     * @param [in] other The reference to assign.
+     *
+     * @return Reference to this.
+     */
+    Ref &operator=(Ref other) noexcept
+    {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    /// Releases the reference and makes it empty.
+    void reset()
+    {
+        Ref().swap(*this);
+    }
+
+    /**
+     * Swaps two references.
+     *
+     * @param [in,out] other The reference to swap with.
+     */
+    void swap(Ref &other) noexcept
+    {
+        std::swap(ptr, other.ptr);
+    }
+
+    /// @return The referenced object.
+    T *get() const
+    {
+        return ptr;
+    }
+
+    /// @return The referenced object.
+    T &operator*() const
+    {
+        return *ptr;
+    }
+
+    /// @return The referenced object.
+    T *operator->() const
+    {
+        return ptr;
+    }
+
+    /// @return True if it refers to an object.
+    explicit operator bool() const
+    {
+        return ptr != nullptr;
+    }
+
+    /// @return The number of references to the object, 0 if empty.
+    long use_count() const
+    {
+        return ptr ? ptr->getRefCount() : 0;
+    }
+
+    /**
+     * @param [in] other The reference to compare to.
+     *
+     * @return True if both refer to the same object.
+     */
+    template <class U> bool operator==(const Ref<U> &other) const
+    {
+        return ptr == other.ptr;
+    }
+
+    /**
+     * @param [in] other The reference to compare to.
+     *
+     * @return True if they refer to different objects.
+     */
+    template <class U> bool operator!=(const Ref<U> &other) const
+    {
+        return ptr != other.ptr;
+    }
+
+    /// @return True if the reference is empty.
+    bool operator==(std::nullptr_t) const
+    {
+        return ptr == nullptr;
+    }
+
+    /// @return True if the reference is not empty.
+    bool operator!=(std::nullptr_t) const
+    {
+        return ptr != nullptr;
+    }
+};
+} // namespace pfx
@@ -0,0 +1,97 @@
+namespace pfx
+{
+/// Source buffer that owns a string.
+struct StringSource : SourceBuffer
+{
+    std::string text;
+
+    StringSource(std::string source) : text(std::move(source))
+    {
+        begin = text.data();
+        end = begin + text.size();
+    }
+};
+
+/// Source buffer that owns a read only file mapping.
+struct MappedFileSource : SourceBuffer
+{
+    void *address;
+    size_t length;
+
+    MappedFileSource(void *address, size_t length)
+        : address(address), length(length)
+    {
+        begin = static_cast<const char *>(address);
+        end = begin + length;
+    }
+
+    ~MappedFileSource() override
+    {
+        munmap(address, length);
+    }
+};
+
+SourceRef createStringSource(std::string text)
+{
+    return std::make_shared<StringSource>(std::move(text));
+}
+
+static SourceRef readWholeFile(int fd, const char *file)
+{
+    std::string text;
+    char chunk[65536];
+
+    for (;;)
+    {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n == 0) break;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            int readError = errno;
+            close(fd);
+            throw error::FailedToOpenFile(
+                Position(), ssprintf("%s: %s", file, strerror(readError)));
+        }
+        text.append(chunk, n);
+    }
+    close(fd);
+
+    return createStringSource(std::move(text));
+}
+
+SourceRef openFileSource(const char *file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        throw error::FailedToOpenFile(
+            Position(), ssprintf("%s: %s", file, strerror(errno)));
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode))
+    {
+        // Not something we can map, read it the old way.
+        return readWholeFile(fd, file);
+    }
+    if (st.st_size == 0)
+    {
+        // Zero length mappings are not allowed.
+        close(fd);
+        return createStringSource(std::string());
+    }
+
+    size_t length = st.st_size;
+    void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        return readWholeFile(fd, file);
+    }
+    // The mapping keeps the file referenced, the descriptor is not needed.
+    close(fd);
+    madvise(address, length, MADV_SEQUENTIAL);
+
+    return std::make_shared<MappedFileSource>(address, length);
+}
+} // namespace pfx
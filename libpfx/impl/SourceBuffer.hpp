@@ -0,0 +1,52 @@
+/// @file SourceBuffer.hpp Contains the SourceBuffer class.
+
+namespace pfx
+{
+/**
+ * Owns the bytes of a source code as a single contiguous range.
+ *
+ * @remarks
+ * The range stays valid as long as the buffer is alive, so the readers can
+ * scan it with plain pointers.
+ */
+struct SourceBuffer
+{
+    const char *begin = nullptr; ///< The first byte of the source.
+    const char *end = nullptr;   ///< One after the last byte of the source.
+
+    SourceBuffer()
+    {
+    }
+
+    /// Virtual destructor for polymorphism.
+    virtual ~SourceBuffer()
+    {
+    }
+
+private:
+    // Owned via references, do not copy.
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+};
+
+/**
+ * Creates a source buffer that holds a copy of the given string.
+ *
+ * @param [in] text The source code.
+ *
+ * @return The buffer.
+ */
+SourceRef createStringSource(std::string text);
+
+/**
+ * Creates a source buffer from a file. Regular files are memory mapped, other
+ * files (pipes, devices) are read into memory.
+ *
+ * @param [in] file The file to open.
+ *
+ * @return The buffer.
+ *
+ * @throw error::FailedToOpenFile When the file cannot be opened or read.
+ */
+SourceRef openFileSource(const char *file);
+} // namespace pfx
@@ -0,0 +1,49 @@
+namespace pfx
+{
+void SourceMap::buildIndex() const
+{
+    for (const char *p = source->begin; p != source->end; p++)
+    {
+        if (*p == '\r') crOffsets.push_back(p - source->begin);
+        if (*p == '\n') lfOffsets.push_back(p - source->begin);
+    }
+}
+
+void SourceMap::resolve(size_t offset, int &line, int &column) const
+{
+    std::call_once(indexed, [this] { buildIndex(); });
+
+    // Line breaks before the offset.
+    auto cr = std::lower_bound(crOffsets.begin(), crOffsets.end(), offset);
+    auto lf = std::lower_bound(lfOffsets.begin(), lfOffsets.end(), offset);
+    size_t crCount = cr - crOffsets.begin();
+    size_t lfCount = lf - lfOffsets.begin();
+
+    line = (crCount > lfCount ? crCount : lfCount) + 1;
+
+    // The line starts after the last line break.
+    size_t lineStart = 0;
+    if (crCount) lineStart = crOffsets[crCount - 1] + 1;
+    if (lfCount && (lfOffsets[lfCount - 1] + 1 > lineStart))
+    {
+        lineStart = lfOffsets[lfCount - 1] + 1;
+    }
+
+    int col = 0; // Zero based but we add +1 when returning it.
+    for (size_t i = lineStart; i < offset; i++)
+    {
+        if (source->begin[i] == '\t')
+        {
+            // Then round it up to the next tab stop.
+            col /= tabSize;
+            col++;
+            col *= tabSize;
+        }
+        else
+        {
+            col++;
+        }
+    }
+    column = col + 1;
+}
+} // namespace pfx
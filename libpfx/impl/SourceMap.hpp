@@ -0,0 +1,69 @@
+/// @file SourceMap.hpp Contains the SourceMap class.
+
+namespace pfx
+{
+/**
+ * Turns byte offsets of a source into line and column numbers.
+ *
+ * @remarks
+ * Positions are recorded as byte offsets during parsing, lines and columns are
+ * only needed when an error is reported. So the line index is built on the
+ * first lookup.
+ */
+class SourceMap
+{
+    SourceRef source; // The bytes the offsets refer to.
+    const char *fn;   // Filename is just stored to know what to report.
+    int tabSize;      // The number of spaces in a tab stop.
+
+    /* The line index: offsets of every CR and LF in the source. The line
+     * count is determined by whichever has more, this works well with \n
+     * and \r\n and \r line endings.
+     */
+    mutable std::once_flag indexed;
+    mutable std::vector<size_t> crOffsets;
+    mutable std::vector<size_t> lfOffsets;
+
+    // Builds the line index.
+    void buildIndex() const;
+
+    // Owned via references, do not copy.
+    SourceMap(const SourceMap &) = delete;
+    SourceMap &operator=(const SourceMap &) = delete;
+
+public:
+    /**
+     * Creates a source map.
+     *
+     * @param [in] filename The name of the file to report.
+     * @param [in] source The source code.
+     * @param [in] tabSize The number of spaces in a tab stop.
+     */
+    SourceMap(const char *filename, SourceRef source, int tabSize)
+        : source(std::move(source)), fn(filename), tabSize(tabSize)
+    {
+    }
+
+    /// @return The name of the file.
+    const char *getFileName() const
+    {
+        return fn;
+    }
+
+    /// @return The source code the map is for.
+    const SourceRef &getSource() const
+    {
+        return source;
+    }
+
+    /**
+     * Computes the line and column of a byte offset.
+     *
+     * @param [in] offset The offset in the source.
+     * @param [out] line The one based line number.
+     * @param [out] column The one based column number, tabs are rounded up to
+     * the next tab stop.
+     */
+    void resolve(size_t offset, int &line, int &column) const;
+};
+} // namespace pfx
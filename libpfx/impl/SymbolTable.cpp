@@ -0,0 +1,168 @@
+namespace pfx
+{
+CommandNode *SymbolTable::find(std::string_view name) const
+{
+    uint64_t h = hash(name);
+
+    if (!sealed.empty())
+    {
+        const CommandRef &node = sealed[sealedIndex(h)];
+        if (node && (node->prettyName == name)) return node.get();
+    }
+
+    if (slots.empty())
+    {
+        return nullptr;
+    }
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask)
+    {
+        const Slot &slot = slots[i];
+        if (!slot.node) return nullptr;
+        if ((slot.hash == h) && (slot.node->prettyName == name))
+        {
+            return slot.node.get();
+        }
+    }
+}
+
+void SymbolTable::place(uint64_t hash, CommandRef node)
+{
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    while (slots[i].node)
+    {
+        i = (i + 1) & mask;
+    }
+    slots[i].hash = hash;
+    slots[i].node = std::move(node);
+}
+
+void SymbolTable::rehash(size_t newSize)
+{
+    std::vector<Slot> old(newSize);
+    old.swap(slots);
+    for (Slot &slot : old)
+    {
+        if (slot.node) place(slot.hash, std::move(slot.node));
+    }
+}
+
+void SymbolTable::insert(CommandRef node)
+{
+    // Keep the load factor under 3/4.
+    if ((count + 1) * 4 > slots.size() * 3)
+    {
+        rehash(std::max<size_t>(64, slots.size() * 2));
+    }
+    uint64_t h = hash(node->prettyName);
+    place(h, std::move(node));
+    count++;
+}
+
+void SymbolTable::seal()
+{
+    std::vector<CommandRef> nodes;
+    for (CommandRef &node : sealed)
+    {
+        if (node) nodes.push_back(std::move(node));
+    }
+    for (Slot &slot : slots)
+    {
+        if (slot.node) nodes.push_back(std::move(slot.node));
+    }
+    slots.clear();
+    sealed.clear();
+    sealedNodes = 0;
+    count = 0;
+
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    std::vector<uint64_t> hashes;
+    for (const CommandRef &node : nodes)
+    {
+        hashes.push_back(hash(node->prettyName));
+    }
+
+    // Names with colliding hashes can't be separated by any seed.
+    std::vector<uint64_t> sorted = hashes;
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+    {
+        for (CommandRef &node : nodes)
+        {
+            insert(std::move(node));
+        }
+        return;
+    }
+
+    // Start at a load factor of at most 1/2 and search for a seed that maps
+    // every name to a different slot. Grow the table if that takes long.
+    int bits = 1;
+    while ((size_t(1) << bits) < nodes.size() * 2)
+    {
+        bits++;
+    }
+    std::vector<bool> used;
+    for (; bits < 32; bits++)
+    {
+        sealedShift = 64 - bits;
+        for (sealedSeed = 1; sealedSeed <= 1000; sealedSeed++)
+        {
+            used.assign(size_t(1) << bits, false);
+            bool collision = false;
+            for (uint64_t h : hashes)
+            {
+                size_t i = sealedIndex(h);
+                if (used[i])
+                {
+                    collision = true;
+                    break;
+                }
+                used[i] = true;
+            }
+            if (!collision)
+            {
+                sealed.resize(size_t(1) << bits);
+                for (size_t i = 0; i < nodes.size(); i++)
+                {
+                    sealed[sealedIndex(hashes[i])] = std::move(nodes[i]);
+                }
+                sealedNodes = nodes.size();
+                return;
+            }
+        }
+    }
+
+    // No seed was found, keep the names in the normal table.
+    for (CommandRef &node : nodes)
+    {
+        insert(std::move(node));
+    }
+}
+
+void SymbolTable::sweep(bool (*isUnused)(const CommandNode &node))
+{
+    if (count < sweepLimit)
+    {
+        return;
+    }
+
+    for (Slot &slot : slots)
+    {
+        if (slot.node && (slot.node.use_count() == 1) && isUnused(*slot.node))
+        {
+            slot.node = nullptr;
+            count--;
+        }
+    }
+    // The probe sequences are broken by the holes, so place everything again.
+    rehash(slots.size());
+
+    sweepLimit = std::max<size_t>(1024, count * 2);
+}
+} // namespace pfx
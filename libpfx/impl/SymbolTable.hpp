@@ -0,0 +1,111 @@
+/// @file SymbolTable.hpp Contains the SymbolTable class.
+
+namespace pfx
+{
+/**
+ * Maps command names to their command nodes.
+ *
+ * @remarks
+ * The names are interned in the command nodes themselves: the table is keyed
+ * by the prettyName of the node it stores, so a lookup is one hash of the token
+ * and usually a single string comparison.
+ *
+ * The table is open addressed with linear probing. The commands sealed by
+ * seal() are moved to a separate, collision free table that is checked first,
+ * so looking up a builtin never probes.
+ */
+class SymbolTable
+{
+    struct Slot
+    {
+        uint64_t hash = 0;
+        CommandRef node;
+    };
+
+    // Open addressed table, the size is a power of two or zero.
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    // Perfect hash table of the sealed commands, indexed by sealedIndex().
+    std::vector<CommandRef> sealed;
+    size_t sealedNodes = 0; // The number of nodes in sealed.
+    uint64_t sealedSeed = 0;
+    int sealedShift = 0;
+
+    size_t sweepLimit = 1024; // Sweep when the table grows this big.
+
+    size_t sealedIndex(uint64_t hash) const
+    {
+        return ((hash ^ sealedSeed) * 0x9E3779B97F4A7C15ull) >> sealedShift;
+    }
+
+    // Places the node into the open addressed table, no duplicate checking.
+    void place(uint64_t hash, CommandRef node);
+
+    // Rebuilds the open addressed table with the given number of slots.
+    void rehash(size_t newSize);
+
+public:
+    /**
+     * @param [in] name The name to hash.
+     *
+     * @return The hash of the name (64 bit FNV-1a).
+     */
+    static uint64_t hash(std::string_view name)
+    {
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (char c : name)
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    /**
+     * @param [in] name The command name to look for.
+     *
+     * @return The command node of the name, nullptr if it's not in the table.
+     */
+    CommandNode *find(std::string_view name) const;
+
+    /**
+     * Adds a command node, its prettyName is the key.
+     *
+     * @param [in] node The node to add. There must be no node with the same
+     * name in the table.
+     */
+    void insert(CommandRef node);
+
+    /// @return The number of commands in the table.
+    size_t size() const
+    {
+        return count + sealedCount();
+    }
+
+    /// @return The number of sealed commands.
+    size_t sealedCount() const
+    {
+        return sealedNodes;
+    }
+
+    /**
+     * Moves every command in the table into the perfect hash table.
+     *
+     * @remarks
+     *  Meant to be called once the fixed set of builtins is registered. The
+     * nodes stay the same, so they can still be rebound; commands added later
+     * go to the normal table.
+     */
+    void seal();
+
+    /**
+     * Removes the commands that are not sealed, are referred only by the table
+     * and the predicate accepts. It only happens when the table grew big
+     * enough since the last sweep.
+     *
+     * @param [in] isUnused Called for the candidates, returns true for the
+     * ones that can go.
+     */
+    void sweep(bool (*isUnused)(const CommandNode &node));
+};
+} // namespace pfx
@@ -0,0 +1,26 @@
+namespace pfx
+{
+thread_local Node *TailCall::target = nullptr;
+
+
+Value TailCall::request(NodeRef group)
+{
+    cancel();
+    target = group.get();
+    if (target) target->addRef();
+    return Value();
+}
+
+
+NodeRef TailCall::take()
+{
+    NodeRef group(target);
+    if (target)
+    {
+        // The reference of the request is now held by group.
+        target->release();
+        target = nullptr;
+    }
+    return group;
+}
+} // namespace pfx
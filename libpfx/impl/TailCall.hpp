@@ -0,0 +1,53 @@
+/// @file TailCall.hpp Contains the TailCall class.
+
+namespace pfx
+{
+/**
+ * The tail call request of the current thread, a trampoline for the functions
+ * implemented by commands.
+ *
+ * @remarks
+ *  A command requests a tail call then returns normally. While the request is
+ * pending, the groups, the bytecode engine and the argument reading stop
+ * evaluating and return null, so the evaluation unwinds by returning. The
+ * command running the function checks for the request when its body returns,
+ * takes it and continues with the requested group in the same loop.
+ *
+ * Commands that read arguments through an iterator still run, but they only
+ * get nulls from then on. So the request should be made in a tail position.
+ */
+class TailCall
+{
+    // The requested group, owns a reference.
+    static thread_local Node *target;
+
+public:
+    /// @return True if a tail call is requested and not taken yet.
+    static bool pending()
+    {
+        return target;
+    }
+
+    /**
+     * Requests a tail call.
+     *
+     * @param [in] group The group to continue with.
+     *
+     * @return A null value to return from the command.
+     */
+    static Value request(NodeRef group);
+
+    /**
+     * Takes the pending request.
+     *
+     * @return The requested group, empty reference if there was no request.
+     */
+    static NodeRef take();
+
+    /// Drops the pending request, if any. Call it when an error unwinds.
+    static void cancel()
+    {
+        take();
+    }
+};
+} // namespace pfx
@@ -0,0 +1,218 @@
+namespace pfx
+{
+/// A loop running on the pool.
+class ThreadPool::Job
+{
+public:
+    const std::function<void(size_t)> &task;
+    std::atomic<size_t> remaining;
+    // The lowest index that failed, and its error.
+    std::atomic<size_t> failed{SIZE_MAX};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    Job(const std::function<void(size_t)> &task, size_t count)
+        : task(task), remaining(count)
+    {
+    }
+};
+
+
+thread_local const ThreadPool *ThreadPool::ownerPool = nullptr;
+thread_local size_t ThreadPool::ownQueue = 0;
+
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    resize(threadCount);
+}
+
+
+void ThreadPool::resize(size_t newThreadCount)
+{
+    if (loops > 0)
+    {
+        throw error::InvalidOperation(
+            Position(),
+            "The thread pool can't be resized while it runs a loop.");
+    }
+#ifdef PFX_SINGLE_THREADED
+    newThreadCount = 0;
+#endif
+    stop();
+    threadCount = newThreadCount;
+    // The last queue is where the other threads deal their loops.
+    queues.clear();
+    for (size_t i = 0; i <= threadCount; i++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+
+size_t ThreadPool::hardwareThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+void ThreadPool::start()
+{
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back([this, i] { work(i); });
+    }
+    started = true;
+}
+
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    stopping = false;
+    started = false;
+}
+
+
+void ThreadPool::work(size_t index)
+{
+    ownerPool = this;
+    ownQueue = index;
+    for (;;)
+    {
+        if (runOne(index)) continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return stopping || (queued > 0); });
+        if (stopping) return;
+    }
+}
+
+
+bool ThreadPool::runOne(size_t first)
+{
+    // The own queue from the back, it's the most recently dealt work, then
+    // steal from the front of the others.
+    Task task{nullptr, 0};
+    for (size_t i = 0; (i < queues.size()) && !task.job; i++)
+    {
+        Queue &queue = *queues[(first + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (i == 0)
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task.job) return false;
+    queued--;
+
+    Job &job = *task.job;
+    // The tasks after a failed one are skipped, the ones before it may fail
+    // earlier.
+    if (task.index < job.failed)
+    {
+        try
+        {
+            job.task(task.index);
+        }
+        catch (...)
+        {
+            // The error of the lowest index is kept, so it doesn't depend on
+            // the timing.
+            std::lock_guard<std::mutex> lock(job.errorMutex);
+            if (task.index < job.failed)
+            {
+                job.failed = task.index;
+                job.error = std::current_exception();
+            }
+        }
+    }
+    if (job.remaining.fetch_sub(1) == 1) finished(job);
+    return true;
+}
+
+
+void ThreadPool::finished(Job &)
+{
+    // Taking the lock makes sure the waiting thread doesn't miss the wakeup.
+    std::lock_guard<std::mutex> lock(mutex);
+    changed.notify_all();
+}
+
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &task)
+{
+    if (!count) return;
+    if (!threadCount)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+    if (!started)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started) start();
+    }
+    loops++;
+
+    // Counted before they are dealt, a worker taking one counts it down.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued += count;
+    }
+
+    // Deal the tasks out starting from the queue of this thread, so the
+    // nested loops start on their own worker.
+    Job job(task, count);
+    size_t own = ownerPool == this ? ownQueue : threadCount;
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        Queue &queue = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (size_t index = i; index < count; index += queues.size())
+        {
+            queue.tasks.push_back(Task{&job, index});
+        }
+    }
+    changed.notify_all();
+
+    // Help until the loop is done.
+    while (job.remaining > 0)
+    {
+        if (runOne(own)) continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this, &job] {
+            return (job.remaining == 0) || (queued > 0);
+        });
+    }
+
+    loops--;
+    if (job.error) std::rethrow_exception(job.error);
+}
+} // namespace pfx
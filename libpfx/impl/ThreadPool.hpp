@@ -0,0 +1,112 @@
+/// @file ThreadPool.hpp Contains the ThreadPool class.
+
+namespace pfx
+{
+/**
+ * A work stealing pool of threads that runs parallel loops.
+ *
+ * @remarks
+ *  Each worker has its own queue. A loop deals its tasks out among the
+ * queues, the workers take the tasks of their own queue from the back and
+ * steal from the front of the others when theirs is empty. The thread that
+ * runs the loop helps until the loop is done, so the loops can be nested:
+ * a task can run a loop of its own on the same pool.
+ *
+ * The threads are started by the first loop after creating or resizing the
+ * pool. When the library is built with
+ * PFX_SINGLE_THREADED the nodes can't be shared between threads, so the pool
+ * has no threads and runs the loops on the calling thread.
+ */
+class ThreadPool
+{
+    class Job;
+
+    struct Task
+    {
+        Job *job;
+        size_t index;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    size_t threadCount = 0;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<bool> started{false};
+
+    // The loops running on the workers, the pool can't be resized meanwhile.
+    std::atomic<size_t> loops{0};
+
+    // Guards the waiting, the queues have their own locks.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+
+    // Where the workers deal the tasks of their own loops.
+    static thread_local const ThreadPool *ownerPool;
+    static thread_local size_t ownQueue;
+
+    void start();
+    void stop();
+    void work(size_t index);
+    bool runOne(size_t first);
+    void finished(Job &job);
+
+public:
+    /**
+     * Creates the pool, the threads start with the first loop.
+     *
+     * @param [in] threadCount The number of workers, 0 runs the loops on the
+     * calling thread.
+     */
+    explicit ThreadPool(size_t threadCount);
+
+    /// Stops the workers, no loop may be running.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// @return The number of hardware threads, at least 1.
+    static size_t hardwareThreads();
+
+    /// @return The number of workers.
+    size_t size() const
+    {
+        return threadCount;
+    }
+
+    /**
+     * Sets the number of workers.
+     *
+     * @param [in] newThreadCount The number of workers, 0 runs the loops on
+     * the calling thread.
+     *
+     * @throw error::InvalidOperation When a loop is running.
+     *
+     * @remarks
+     *  The workers already started are stopped, the next loop starts the new
+     * ones. No loop may start meanwhile.
+     */
+    void resize(size_t newThreadCount);
+
+    /**
+     * Runs a task for each index in parallel and waits for them.
+     *
+     * @param [in] count The number of tasks.
+     * @param [in] task Runs the task of an index, it's called from the workers
+     * and from this thread at the same time.
+     *
+     * @throw ... The exception of the lowest index that threw, after the
+     * tasks that already started are done. The tasks of the higher indexes
+     * that didn't start yet are skipped, so the error is the one a sequential
+     * loop would throw.
+     */
+    void run(size_t count, const std::function<void(size_t)> &task);
+};
+} // namespace pfx
@@ -13,12 +13,25 @@ struct Token
     /// The ending character position (one character after the last)
     Position end = Position();
 
-    /// The contained word itself.
-    std::string word = std::string();
+    /**
+     * The contained word itself.
+     *
+     * @remarks
+     *  It points into the source buffer the token was read from, so it's only
+     * valid as long as that buffer is alive. The only exception is a quoted
+     * word with escaped quotes, that's stored in the token itself.
+     */
+    std::string_view word = std::string_view();
 
     /// Indicates the the word came from a quoted string.
     bool quoted = false;
 
+    /// Indicates that the word is stored in the token, not in the source.
+    bool escaped = false;
+
+    /// The unescaped word, used only when escaped is true.
+    std::string unescaped = std::string();
+
     /// Default constructor creates empty token.
     Token()
     {
@@ -29,8 +42,39 @@ struct Token
      *
      * @param [in] tokenString The string of the token.
      */
-    Token(std::string tokenString) : word(std::move(tokenString)), quoted(true)
+    Token(std::string tokenString)
+        : quoted(true), escaped(true), unescaped(std::move(tokenString))
+    {
+        word = unescaped;
+    }
+
+    /**
+     * Copies a token.
+     *
+     * @param [in] other The token to copy.
+     */
+    Token(const Token &other)
+    {
+        *this = other;
+    }
+
+    /**
+     * Copies a token.
+     *
+     * @param [in] other The token to copy.
+     *
+     * @return Reference to this.
+     */
+    Token &operator=(const Token &other)
     {
+        start = other.start;
+        end = other.end;
+        quoted = other.quoted;
+        escaped = other.escaped;
+        unescaped = other.unescaped;
+        // The word must point to our own copy if it's not in the source.
+        word = escaped ? std::string_view(unescaped) : other.word;
+        return *this;
     }
 };
 } // namespace pfx
@@ -0,0 +1,340 @@
+namespace pfx
+{
+/// Bit masks of the interesting characters in a 64 byte block.
+struct BlockMasks
+{
+    uint64_t whitespace; ///< Bit i is set when byte i is a whitespace.
+    uint64_t quote;      ///< Bit i is set when byte i is a quote.
+};
+
+#if defined(__AVX2__)
+
+static BlockMasks classifyBlock(const char *p)
+{
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i quote = _mm256_set1_epi8('"');
+    BlockMasks masks = {0, 0};
+
+    for (int i = 0; i < 2; i++)
+    {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i * 32));
+        // 9..13 is whitespace: (v - 9) <= 4 as unsigned.
+        __m256i shifted = _mm256_sub_epi8(v, nine);
+        __m256i control =
+            _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, four), shifted);
+        __m256i ws = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, space));
+        __m256i q = _mm256_cmpeq_epi8(v, quote);
+
+        masks.whitespace |=
+            uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << (i * 32);
+        masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(q))) << (i * 32);
+    }
+    return masks;
+}
+
+#elif defined(__SSE2__)
+
+static BlockMasks classifyBlock(const char *p)
+{
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i quote = _mm_set1_epi8('"');
+    BlockMasks masks = {0, 0};
+
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 16));
+        // 9..13 is whitespace: (v - 9) <= 4 as unsigned.
+        __m128i shifted = _mm_sub_epi8(v, nine);
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, four), shifted);
+        __m128i ws = _mm_or_si128(control, _mm_cmpeq_epi8(v, space));
+        __m128i q = _mm_cmpeq_epi8(v, quote);
+
+        masks.whitespace |= uint64_t(_mm_movemask_epi8(ws)) << (i * 16);
+        masks.quote |= uint64_t(_mm_movemask_epi8(q)) << (i * 16);
+    }
+    return masks;
+}
+
+#else
+
+static BlockMasks classifyBlock(const char *p)
+{
+    BlockMasks masks = {0, 0};
+
+    for (int i = 0; i < 64; i++)
+    {
+        masks.whitespace |= uint64_t(isWhitespace(p[i])) << i;
+        masks.quote |= uint64_t(p[i] == '"') << i;
+    }
+    return masks;
+}
+
+#endif
+
+/// @return The bits of the mask from position i upwards.
+static inline uint64_t bitsFrom(uint64_t mask, int i)
+{
+    return mask & (~uint64_t(0) << i);
+}
+
+namespace
+{
+/// Where the tokenizer is in the source.
+enum class State
+{
+    Outside,   // Between tokens.
+    InWord,    // In an unquoted word.
+    InQuote,   // Between quotes.
+    AfterQuote // Right after a quote that may close the quoted word.
+};
+
+/// The state of the tokenizer at the edge of a chunk.
+struct Edge
+{
+    State state = State::Outside;
+    size_t start = 0; // The start of the quoted token the chunk continues.
+    uint8_t flag = 0; // Its flags so far.
+};
+
+/// Counts the tokens of a chunk.
+struct Counter
+{
+    size_t count = 0;
+
+    void operator()(size_t, size_t, uint8_t)
+    {
+        count++;
+    }
+};
+
+/// Writes the tokens of a chunk into their place in the table.
+struct Writer
+{
+    TokenTable &table;
+    size_t next; // Where the next token goes.
+
+    void operator()(size_t offset, size_t length, uint8_t flag)
+    {
+        table.offsets[next] = offset;
+        table.lengths[next] = length;
+        table.flags[next] = flag;
+        next++;
+    }
+};
+} // namespace
+
+/**
+ * Tokenizes a chunk of the source.
+ *
+ * @param [in] begin The first byte of the source.
+ * @param [in] from Where the chunk starts.
+ * @param [in] to Where the chunk ends. Unless it's the end of the source, the
+ * byte there must be a whitespace.
+ * @param [in] last True if the chunk ends the source.
+ * @param [in] entry The state at the start of the chunk.
+ * @param [in,out] add Called with the offset, length and flags of each token.
+ *
+ * @return The state at the end of the chunk, Outside or InQuote. The tokens
+ * cut by the end of the chunk are finished, except the quoted one.
+ */
+template <class Add>
+static Edge tokenizeChunk(const char *begin, size_t from, size_t to,
+                          bool last, Edge entry, Add &add)
+{
+    State state = entry.state;
+    size_t start = entry.start;
+    uint8_t flag = entry.flag;
+
+    for (size_t blockStart = from; blockStart < to; blockStart += 64)
+    {
+        const char *block = begin + blockStart;
+        char padded[64];
+
+        if (to - blockStart < 64)
+        {
+            // The last partial block is padded with whitespace, it ends the
+            // last word just like the whitespace after the chunk does.
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, block, to - blockStart);
+            block = padded;
+        }
+
+        BlockMasks masks = classifyBlock(block);
+        int i = 0;
+
+        while (i < 64)
+        {
+            uint64_t m;
+
+            switch (state)
+            {
+            case State::Outside:
+                m = bitsFrom(~masks.whitespace, i);
+                if (!m)
+                {
+                    i = 64;
+                    break;
+                }
+                i = __builtin_ctzll(m);
+                start = blockStart + i;
+                flag = 0;
+                state = (masks.quote >> i) & 1 ? State::InQuote : State::InWord;
+                i++;
+                break;
+            case State::InWord:
+                m = bitsFrom(masks.whitespace, i);
+                if (!m)
+                {
+                    i = 64;
+                    break;
+                }
+                i = __builtin_ctzll(m);
+                add(start, blockStart + i - start, 0);
+                state = State::Outside;
+                break;
+            case State::InQuote:
+                m = bitsFrom(masks.quote, i);
+                if (!m)
+                {
+                    i = 64;
+                    break;
+                }
+                i = __builtin_ctzll(m) + 1;
+                state = State::AfterQuote;
+                break;
+            case State::AfterQuote:
+                if ((masks.quote >> i) & 1)
+                {
+                    // Doubled quote, the string goes on.
+                    flag |= TokenTable::Escaped;
+                    state = State::InQuote;
+                    i++;
+                }
+                else
+                {
+                    add(start, blockStart + i - start,
+                                flag | TokenTable::Quoted);
+                    state = State::Outside;
+                }
+                break;
+            }
+        }
+    }
+
+    // Finish the word the end of the chunk cut.
+    switch (state)
+    {
+    case State::Outside:
+        break;
+    case State::InWord:
+        add(start, to - start, 0);
+        break;
+    case State::InQuote:
+        if (!last) return Edge{state, start, flag};
+        add(start, to - start,
+                    flag | TokenTable::Quoted | TokenTable::Unterminated);
+        break;
+    case State::AfterQuote:
+        add(start, to - start, flag | TokenTable::Quoted);
+        break;
+    }
+    return Edge();
+}
+
+void tokenize(const char *begin, const char *end, TokenTable &table)
+{
+    table.clear();
+    table.reserve((end - begin) / 4);
+    auto push = [&table](size_t offset, size_t length, uint8_t flag) {
+        table.push(offset, length, flag);
+    };
+    tokenizeChunk(begin, 0, end - begin, true, Edge(), push);
+}
+
+void tokenize(const char *begin, const char *end, TokenTable &table,
+              ThreadPool &pool, size_t minChunkSize)
+{
+    // The chunks are scanned twice, to count the tokens then to write them,
+    // it takes a few threads to win.
+    size_t total = end - begin;
+    size_t chunkCount = std::min(total / std::max<size_t>(minChunkSize, 1),
+                                 pool.size() * 8 + 1);
+    if ((chunkCount < 2) || (pool.size() < 3))
+    {
+        tokenize(begin, end, table);
+        return;
+    }
+
+    // The chunks end at whitespace, so only the quoted tokens can cross.
+    std::vector<size_t> edges{0};
+    for (size_t i = 1; i < chunkCount; i++)
+    {
+        size_t edge = std::max(total / chunkCount * i, edges.back());
+        while ((edge < total) && !isWhitespace(begin[edge])) edge++;
+        if (edge > edges.back()) edges.push_back(edge);
+    }
+    if (edges.back() < total) edges.push_back(total);
+    chunkCount = edges.size() - 1;
+
+    // Count the tokens as if each chunk started between tokens, the usual
+    // case.
+    std::vector<Edge> entries(chunkCount), exits(chunkCount);
+    std::vector<size_t> counts(chunkCount);
+    pool.run(chunkCount, [&](size_t i) {
+        Counter counter;
+        exits[i] = tokenizeChunk(begin, edges[i], edges[i + 1],
+                                 i + 1 == chunkCount, Edge(), counter);
+        counts[i] = counter.count;
+    });
+
+    // Count again the chunks that continue a string, in order. They are rare.
+    for (size_t i = 1; i < chunkCount; i++)
+    {
+        entries[i] = exits[i - 1];
+        if (entries[i].state == State::Outside) continue;
+        Counter counter;
+        exits[i] = tokenizeChunk(begin, edges[i], edges[i + 1],
+                                 i + 1 == chunkCount, entries[i], counter);
+        counts[i] = counter.count;
+    }
+
+    // Then each chunk writes its tokens into their place.
+    std::vector<size_t> firsts{0};
+    for (size_t count : counts)
+    {
+        firsts.push_back(firsts.back() + count);
+    }
+    table.clear();
+    table.offsets.resize(firsts.back());
+    table.lengths.resize(firsts.back());
+    table.flags.resize(firsts.back());
+    pool.run(chunkCount, [&](size_t i) {
+        Writer writer{table, firsts[i]};
+        tokenizeChunk(begin, edges[i], edges[i + 1], i + 1 == chunkCount,
+                      entries[i], writer);
+    });
+}
+
+std::string unescapeQuotes(std::string_view text)
+{
+    std::string result;
+
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        result.push_back(text[i]);
+        // The second quote of a doubled pair is skipped.
+        if ((text[i] == '"') && (i + 1 < text.size()) && (text[i + 1] == '"'))
+        {
+            i++;
+        }
+    }
+    return result;
+}
+} // namespace pfx
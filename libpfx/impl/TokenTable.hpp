@@ -0,0 +1,161 @@
+/// @file TokenTable.hpp Contains the TokenTable class.
+
+namespace pfx
+{
+/**
+ * An allocator that leaves the elements uninitialized when a vector is resized,
+ * the parallel tokenizer writes every one of them on its threads.
+ */
+template <class T> struct UninitializedAllocator : std::allocator<T>
+{
+    template <class U> struct rebind
+    {
+        using other = UninitializedAllocator<U>;
+    };
+
+    UninitializedAllocator() = default;
+
+    template <class U>
+    UninitializedAllocator(const UninitializedAllocator<U> &) noexcept
+    {
+    }
+
+    /// Default initializes, which leaves the trivial types as they are.
+    template <class U> void construct(U *p)
+    {
+        ::new (static_cast<void *>(p)) U;
+    }
+
+    template <class U, class... Args> void construct(U *p, Args &&... args)
+    {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+/// A vector that doesn't clear its new elements on resize.
+template <class T>
+using UninitializedVector = std::vector<T, UninitializedAllocator<T>>;
+
+/**
+ * The tokens of a whole source in a compact struct of arrays form.
+ *
+ * @remarks
+ * Each token is described by the byte range it occupies in the source (for
+ * quoted tokens the quotes included) and its flags. The text itself is not
+ * copied, use text() to get it.
+ */
+struct TokenTable
+{
+    static const uint8_t Quoted = 1;       ///< The token is a quoted string.
+    static const uint8_t Escaped = 2;      ///< It contains doubled quotes.
+    static const uint8_t Unterminated = 4; ///< The closing quote is missing.
+
+    UninitializedVector<size_t> offsets; ///< Where the tokens start.
+    UninitializedVector<size_t> lengths; ///< How many bytes they occupy.
+    UninitializedVector<uint8_t> flags;  ///< The flags of the tokens.
+
+    /// @return The number of tokens.
+    size_t size() const
+    {
+        return offsets.size();
+    }
+
+    /// Removes all tokens.
+    void clear()
+    {
+        offsets.clear();
+        lengths.clear();
+        flags.clear();
+    }
+
+    /**
+     * Reserves space for tokens.
+     *
+     * @param [in] n The number of tokens to reserve space for.
+     */
+    void reserve(size_t n)
+    {
+        offsets.reserve(n);
+        lengths.reserve(n);
+        flags.reserve(n);
+    }
+
+    /**
+     * Adds a token to the end of the table.
+     *
+     * @param [in] offset The start of the token in the source.
+     * @param [in] length The number of bytes it occupies.
+     * @param [in] flag The flags of the token.
+     */
+    void push(size_t offset, size_t length, uint8_t flag)
+    {
+        offsets.push_back(offset);
+        lengths.push_back(length);
+        flags.push_back(flag);
+    }
+
+    /**
+     * @param [in] base The beginning of the source the table was made from.
+     * @param [in] i The index of the token.
+     *
+     * @return The text of the token, for quoted tokens it's the text between
+     * the quotes. Doubled quotes are left as is.
+     */
+    std::string_view text(const char *base, size_t i) const
+    {
+        const char *start = base + offsets[i];
+        size_t length = lengths[i];
+
+        if (flags[i] & Quoted)
+        {
+            // Skip the opening and closing quotes.
+            start++;
+            length -= (flags[i] & Unterminated) ? 1 : 2;
+        }
+        return std::string_view(start, length);
+    }
+};
+
+/**
+ * Splits a source into tokens. The same way as readWord would do.
+ *
+ * @param [in] begin The first byte of the source.
+ * @param [in] end One after the last byte of the source.
+ * @param [out] table The tokens found, it's cleared first.
+ *
+ * @remarks
+ *  It classifies the bytes in 64 byte blocks, using AVX2 or SSE2 when the
+ * library is compiled with them, scalar code otherwise.
+ */
+void tokenize(const char *begin, const char *end, TokenTable &table);
+
+/**
+ * Splits a source into tokens on the threads of the pool. The tokens are the
+ * same as the ones of the serial tokenize().
+ *
+ * @param [in] begin The first byte of the source.
+ * @param [in] end One after the last byte of the source.
+ * @param [out] table The tokens found, it's cleared first.
+ * @param [in,out] pool The threads to tokenize on.
+ * @param [in] minChunkSize The smallest number of bytes worth a thread.
+ *
+ * @remarks
+ *  The source is split into chunks at whitespace, so only a quoted token can
+ * cross the edges. The tokens of the chunks are counted in parallel as if
+ * they started between tokens. Then a sequential pass follows the state from
+ * chunk to chunk and counts again the few that start in a string. Finally
+ * the chunks write their tokens into their place in parallel.
+ *
+ * The chunks are scanned twice, so sources smaller than two chunks and pools
+ * of less than 3 workers are tokenized serially.
+ */
+void tokenize(const char *begin, const char *end, TokenTable &table,
+              ThreadPool &pool, size_t minChunkSize = 1 << 20);
+
+/**
+ * @param [in] text The text of a quoted token.
+ *
+ * @return The text with doubled quotes turned into single ones.
+ */
+std::string unescapeQuotes(std::string_view text);
+} // namespace pfx
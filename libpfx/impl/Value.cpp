@@ -0,0 +1,17 @@
+namespace pfx
+{
+
+std::string Value::toString() const
+{
+    switch (tag)
+    {
+    case Tag::Integer:
+        return ssprintf("%d", integer);
+    case Tag::Float:
+        return ssprintf("%g", floating);
+    default:
+        return node ? node->toString() : "null";
+    }
+}
+
+} // namespace pfx
@@ -0,0 +1,262 @@
+/// @file Value.hpp Contains the Value class.
+
+namespace pfx
+{
+/**
+ * The result of an evaluation.
+ *
+ * @remarks
+ *  Integers and floats are stored inline, everything else is held by a node
+ * reference. This way arithmetic doesn't need to allocate a node for each
+ * intermediate result, a node is only created when toNode() is called.
+ *
+ * A value can also borrow a node without a reference, see Borrow. Copying or
+ * moving it takes a reference, so only the borrowed value itself must not
+ * outlive the node.
+ */
+class Value
+{
+    enum class Tag : uint8_t
+    {
+        Integer,
+        Float,
+        Node,
+        Borrowed // A node without a reference.
+    };
+
+    Tag tag;
+
+    union
+    {
+        int integer;
+        double floating;
+        Node *node;
+    };
+
+public:
+    /// Selects the constructor that borrows the node.
+    struct Borrow
+    {
+    };
+
+    /// Creates a null value.
+    Value() : tag(Tag::Node), node(nullptr)
+    {
+    }
+
+    /**
+     * Creates an integer value.
+     *
+     * @param [in] value The value to store.
+     */
+    explicit Value(int value) : tag(Tag::Integer), integer(value)
+    {
+    }
+
+    /**
+     * Creates a floating point value.
+     *
+     * @param [in] value The value to store.
+     */
+    explicit Value(double value) : tag(Tag::Float), floating(value)
+    {
+    }
+
+    /**
+     * Creates a value that refers to a node.
+     *
+     * @param [in] ref The node. An empty reference means null.
+     */
+    template <class T>
+    Value(const Ref<T> &ref) : tag(Tag::Node), node(ref.get())
+    {
+        if (node) node->addRef();
+    }
+
+    /**
+     * Creates a value that borrows a node, without changing its reference
+     * count.
+     *
+     * @param [in] node The node. It must outlive this value, like the argument
+     * nodes outlive the call of the command.
+     */
+    Value(const Node &node, Borrow)
+        : tag(Tag::Borrowed), node(const_cast<Node *>(&node))
+    {
+    }
+
+    /**
+     * Copies the value. A borrowed node is referenced by the copy.
+     *
+     * @param [in] other The value to copy.
+     */
+    Value(const Value &other) : tag(other.tag), node(other.node)
+    {
+        switch (tag)
+        {
+        case Tag::Integer:
+            integer = other.integer;
+            break;
+        case Tag::Float:
+            floating = other.floating;
+            break;
+        case Tag::Node:
+        case Tag::Borrowed:
+            tag = Tag::Node;
+            if (node) node->addRef();
+            break;
+        }
+    }
+
+    /**
+     * Takes over the value. A borrowed node is referenced instead.
+     *
+     * @param [in,out] other The value to take, it becomes null.
+     */
+    Value(Value &&other) noexcept : Value()
+    {
+        swap(other);
+        if (tag == Tag::Borrowed)
+        {
+            tag = Tag::Node;
+            if (node) node->addRef();
+        }
+    }
+
+    /// Releases the node if there is one.
+    ~Value()
+    {
+        if ((tag == Tag::Node) && node) node->release();
+    }
+
+    /**
+     * Assigns a value.
+     *
+     * @param [in] other The value to assign.
+     *
+     * @return Reference to this.
+     */
+    Value &operator=(Value other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    /**
+     * Swaps two values. Borrowed values stay borrowed.
+     *
+     * @param [in,out] other The value to swap with.
+     */
+    void swap(Value &other) noexcept
+    {
+        static_assert(sizeof(node) <= sizeof(floating), "Pointer too large.");
+
+        // Whichever member is active, the payload is swapped as raw bytes.
+        char tmp[sizeof(floating)];
+        memcpy(tmp, &floating, sizeof(tmp));
+        memcpy(&floating, &other.floating, sizeof(tmp));
+        memcpy(&other.floating, tmp, sizeof(tmp));
+        std::swap(tag, other.tag);
+    }
+
+    /// @return True if the value is an inline integer.
+    bool isInteger() const
+    {
+        return tag == Tag::Integer;
+    }
+
+    /// @return True if the value is an inline float.
+    bool isFloat() const
+    {
+        return tag == Tag::Float;
+    }
+
+    /// @return The node if the value is held by a node, nullptr otherwise.
+    Node *getNode() const
+    {
+        return (tag == Tag::Node) || (tag == Tag::Borrowed) ? node : nullptr;
+    }
+
+    /**
+     * @return The node downcast as a group node. Empty reference if the value
+     * is not a group.
+     */
+    GroupRef asGroup() const
+    {
+        Node *n = getNode();
+        return n ? n->asGroup() : GroupRef();
+    }
+
+    /**
+     * @return The node downcast as a command node. Empty reference if the
+     * value is not a command.
+     */
+    CommandRef asCommand() const
+    {
+        Node *n = getNode();
+        return n ? n->asCommand() : CommandRef();
+    }
+
+    /// @return The type of the value, the same as its node would have.
+    NodeType getType() const
+    {
+        switch (tag)
+        {
+        case Tag::Integer:
+            return NodeType::Integer;
+        case Tag::Float:
+            return NodeType::FloatingPoint;
+        default:
+            return node ? node->getType() : NodeType::Null;
+        }
+    }
+
+    /// @return The value converted to integer, like Node::toInteger().
+    int toInteger() const
+    {
+        switch (tag)
+        {
+        case Tag::Integer:
+            return integer;
+        case Tag::Float:
+            return floating;
+        default:
+            return node ? node->toInteger() : 0;
+        }
+    }
+
+    /// @return The value converted to double, like Node::toDouble().
+    double toDouble() const
+    {
+        switch (tag)
+        {
+        case Tag::Integer:
+            return integer;
+        case Tag::Float:
+            return floating;
+        default:
+            return node ? node->toDouble() : 0.0;
+        }
+    }
+
+    /// @return The value converted to string, like Node::toString().
+    std::string toString() const;
+
+    /**
+     * @return The node representing the value. Integers and floats are boxed
+     * into new nodes (or preallocated ones for small integers).
+     */
+    NodeRef toNode() const
+    {
+        switch (tag)
+        {
+        case Tag::Integer:
+            return createInteger(integer);
+        case Tag::Float:
+            return createFloat(floating);
+        default:
+            return node ? NodeRef(node) : NullNode::instance;
+        }
+    }
+};
+} // namespace pfx
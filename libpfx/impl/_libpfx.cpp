@@ -3,32 +3,104 @@
  */
 #include <cstdarg>
 #include <cstring>
+#include <cerrno>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <ucontext.h>
+#endif
+
+// The sanitizers are told about the stack switches of DepthLimit.
+#if defined(__SANITIZE_ADDRESS__)
+#define PFX_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define PFX_ASAN
+#endif
+#endif
+#if defined(__SANITIZE_THREAD__)
+#define PFX_TSAN
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define PFX_TSAN
+#endif
+#endif
+#if defined(PFX_ASAN)
+#include <sanitizer/common_interface_defs.h>
+#endif
+#if defined(PFX_TSAN)
+#include <sanitizer/tsan_interface.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <atomic>
+#include <memory_resource>
 #include <vector>
 #include <stack>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <charconv>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <string_view>
 #include <stdexcept>
 
 /**
  * MY HEADERS
  */
+#include "Ref.hpp"
 #include "declarations.hpp"
 
 #include "utility.hpp"
+#include "Arena.hpp"
 
-#include "Command.hpp"
 #include "NodeType.hpp"
 #include "Position.hpp"
 #include "Token.hpp"
+#include "TokenTable.hpp"
+#include "CacheSlot.hpp"
 #include "NodeInfo.hpp"
 #include "ArgIterator.hpp"
 #include "Error.hpp"
+#include "ConstantPool.hpp"
+#include "SymbolTable.hpp"
+#include "SourceBuffer.hpp"
+#include "SourceMap.hpp"
 #include "Input.hpp"
+#include "ThreadPool.hpp"
 #include "Context.hpp"
 #include "Node.hpp"
+#include "Value.hpp"
+#include "Environment.hpp"
+#include "CommandNode.hpp"
+#include "TailCall.hpp"
+#include "DepthLimit.hpp"
+#include "Command.hpp"
+#include "CallSite.hpp"
+#include "CallNode.hpp"
+#include "PurityCheck.hpp"
+#include "Bytecode.hpp"
+#include "CompiledProgram.hpp"
 
 
 /**
@@ -36,9 +108,25 @@
  */
 #include "utility.cpp"
 
-#include "Input.cpp"
+#include "SourceBuffer.cpp"
+#include "SourceMap.cpp"
+#include "TokenTable.cpp"
+#include "CacheSlot.cpp"
 #include "ArgIterator.cpp"
 #include "Error.cpp"
+#include "ConstantPool.cpp"
+#include "SymbolTable.cpp"
+#include "ThreadPool.cpp"
 #include "Context.cpp"
 #include "Node.cpp"
+#include "Value.cpp"
+#include "Environment.cpp"
+#include "CommandNode.cpp"
+#include "TailCall.cpp"
+#include "DepthLimit.cpp"
+#include "Command.cpp"
+#include "CallSite.cpp"
+#include "CallNode.cpp"
+#include "PurityCheck.cpp"
+#include "Bytecode.cpp"
 #include "Position.cpp"
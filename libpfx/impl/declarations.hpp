@@ -8,15 +8,26 @@ class Command;
 struct Node;
 struct GroupNode;
 struct CommandNode;
+struct SourceBuffer;
+class SourceMap;
+class Value;
+class Bytecode;
+class ThreadPool;
+class PurityCheck;
+struct Position;
+struct Signature;
 
 /// Shorthand for the Command reference.
 using CommandCallbackRef = std::shared_ptr<Command>;
 /// Shorthand for the node references.
-using NodeRef = std::shared_ptr<Node>;
+using NodeRef = Ref<Node>;
 
 /// Type for command node references
-using CommandRef = std::shared_ptr<CommandNode>;
+using CommandRef = Ref<CommandNode>;
 
 /// Type for group node references.
-using GroupRef = std::shared_ptr<GroupNode>;
+using GroupRef = Ref<GroupNode>;
+
+/// Type for source buffer references.
+using SourceRef = std::shared_ptr<const SourceBuffer>;
 }
\ No newline at end of file
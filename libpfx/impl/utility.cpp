@@ -55,65 +55,148 @@ bool readWord(Input &input, Token &token)
 {
     token = Token();
     token.quoted = false;
+
+    // Scan the buffer directly, the input is only told where we ended up.
+    const char *p = input.data();
+    const char *end = input.dataEnd();
+
     // Consume whitespace.
-    while (isWhitespace(input.peek()))
+    while ((p != end) && isWhitespace(*p))
     {
-        input.get();
+        p++;
     }
-    if (input.eof())
+    input.advance(p);
+    if (p == end)
     {
         // Reached the end, we are done.
         return false;
     }
     // Read the word
     token.start = input.getPosition();
-    if (input.peek() == '"')
+    if (*p == '"')
     {
         // Quoted string mode.
-        while (input.peek() == '"')
+        while ((p != end) && (*p == '"'))
         {
             // This loop is here to handle escaped quotes.
-            input.get();
-            while (input.peek() != '"')
+            const char *chunk = ++p;
+            // Read everything until quote.
+            p = static_cast<const char *>(memchr(p, '"', end - p));
+            if (!p) p = end;
+            if (token.escaped)
+            {
+                token.unescaped.append(chunk, p);
+            }
+            else
             {
-                // Read everything until quote.
-                int c = input.get();
-                if (c == EOF) break;
-                token.word.push_back(c);
+                // No copy needed as long as there are no escaped quotes.
+                token.word = std::string_view(chunk, p - chunk);
             }
-            input.get();
-            if (input.peek() == '"')
+            if (p != end) p++;
+            if ((p != end) && (*p == '"'))
             {
-                // It was an escaped "
-                token.word.push_back('"');
+                // It was an escaped ", from now on we need our own copy.
+                if (!token.escaped)
+                {
+                    token.unescaped.assign(token.word);
+                    token.escaped = true;
+                }
+                token.unescaped.push_back('"');
             }
         }
+        if (token.escaped) token.word = token.unescaped;
         token.quoted = true;
     }
     else
     {
         // Non-quoted
-        while (!isWhitespace(input.peek()))
+        const char *wordStart = p;
+        while ((p != end) && !isWhitespace(*p))
         {
             // Read until next whitespace (or end of file.)
-            int c = input.get();
-            if (c == EOF) break;
-            token.word.push_back(c);
+            p++;
         }
+        token.word = std::string_view(wordStart, p - wordStart);
     }
+    input.advance(p);
     token.end = input.getPosition();
 
     return true;
 }
 
-int stringToInteger(const std::string &str)
+static bool isDigit(char c)
+{
+    return ('0' <= c) && (c <= '9');
+}
+
+WordClass classifyWord(std::string_view word)
+{
+    WordClass result{WordKind::Command, 0, 0.0};
+    const char *p = word.data();
+    const char *end = p + word.size();
+
+    // A leading + is accepted like strtol and strtod did, from_chars doesn't.
+    if ((end - p > 1) && (*p == '+') && (p[1] != '+') && (p[1] != '-')) p++;
+
+    const char *digits = (p != end) && (*p == '-') ? p + 1 : p;
+    if (digits == end)
+    {
+        // Empty or just a sign.
+        return result;
+    }
+
+    const char *q = digits;
+    while ((q != end) && isDigit(*q))
+    {
+        q++;
+    }
+    if (q == end)
+    {
+        // Only digits, it's an integer unless it's out of range.
+        auto r = std::from_chars(p, end, result.integer);
+        if (r.ec == std::errc())
+        {
+            result.kind = WordKind::Integer;
+            return result;
+        }
+    }
+
+    // Most command words are rejected by their first character.
+    char c = *digits;
+    if (!isDigit(c) && (c != '.') && (c != 'i') && (c != 'I') && (c != 'n') &&
+        (c != 'N'))
+    {
+        return result;
+    }
+
+    auto r = std::from_chars(p, end, result.floating);
+    if (r.ptr != end)
+    {
+        return result;
+    }
+    if (r.ec == std::errc::result_out_of_range)
+    {
+        // Let the C library pick infinity or zero, the word is short anyway.
+        result.floating = strtod(std::string(word).c_str(), nullptr);
+    }
+    else if (r.ec != std::errc())
+    {
+        return result;
+    }
+    result.kind = WordKind::Float;
+
+    return result;
+}
+
+int stringToInteger(std::string_view str)
 {
-    return static_cast<int>(strtol(str.c_str(), nullptr, 10));
+    // The view is not zero terminated, short strings are copied without heap.
+    return static_cast<int>(strtol(std::string(str).c_str(), nullptr, 10));
 }
 
-double stringToDouble(const std::string &str)
+double stringToDouble(std::string_view str)
 {
-    return strtod(str.c_str(), nullptr);
+    return strtod(std::string(str).c_str(), nullptr);
 }
 
 } // namespace pfx
@@ -15,7 +15,7 @@ bool isWhitespace(char c);
  *
  * @return The integer representation.
  */
-int stringToInteger(const std::string &string);
+int stringToInteger(std::string_view string);
 /**
  * Converts a string to floating point.
  *
@@ -23,8 +23,37 @@ int stringToInteger(const std::string &string);
  *
  * @return The floating point representation.
  */
-double stringToDouble(const std::string &string);
+double stringToDouble(std::string_view string);
 
+/// What an unquoted word stands for.
+enum class WordKind
+{
+    Integer, ///< It's an integer literal.
+    Float,   ///< It's a floating point literal.
+    Command  ///< Anything else.
+};
+
+/// The result of classifyWord.
+struct WordClass
+{
+    WordKind kind;  ///< The kind of the word.
+    int integer;    ///< The value if it's an integer.
+    double floating; ///< The value if it's a float.
+};
+
+/**
+ * Decides if an unquoted word is an integer, a float or a command and parses
+ * the value in the same go.
+ *
+ * @param [in] word The word to classify.
+ *
+ * @return The kind and value of the word.
+ *
+ * @remarks
+ *  The parsing is locale independent. Integers that don't fit into an int are
+ * treated as floats.
+ */
+WordClass classifyWord(std::string_view word);
 
 class Input;
 class Token;
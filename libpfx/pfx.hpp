@@ -2,22 +2,55 @@
 
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <memory_resource>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <string>
+#include <string_view>
 #include <fstream>
 #include <sstream>
 
+#include "impl/Ref.hpp"
 #include "impl/declarations.hpp"
 #include "impl/utility.hpp"
+#include "impl/Arena.hpp"
 
-#include "impl/Command.hpp"
 #include "impl/NodeType.hpp"
 #include "impl/Position.hpp"
 #include "impl/Token.hpp"
+#include "impl/TokenTable.hpp"
+#include "impl/CacheSlot.hpp"
 #include "impl/NodeInfo.hpp"
 #include "impl/ArgIterator.hpp"
 #include "impl/Node.hpp"
+#include "impl/Value.hpp"
+#include "impl/Environment.hpp"
+#include "impl/CommandNode.hpp"
+#include "impl/TailCall.hpp"
+#include "impl/DepthLimit.hpp"
+#include "impl/Command.hpp"
+#include "impl/CallSite.hpp"
+#include "impl/CallNode.hpp"
+#include "impl/PurityCheck.hpp"
+#include "impl/Bytecode.hpp"
+#include "impl/CompiledProgram.hpp"
 #include "impl/Error.hpp"
+#include "impl/SourceBuffer.hpp"
+#include "impl/SourceMap.hpp"
 #include "impl/Input.hpp"
+#include "impl/ConstantPool.hpp"
+#include "impl/SymbolTable.hpp"
+#include "impl/ThreadPool.hpp"
 #include "impl/Context.hpp"
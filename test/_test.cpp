@@ -1,7 +1,11 @@
 #include "pfx.hpp"
+#include "common_pfx.hpp"
 
 #undef NDEBUG
 #include <assert.h>
+#include <unistd.h>
+
+#include <thread>
 
 int main()
 {
@@ -41,6 +45,8 @@ int main()
         pfx::ArgIterator iter;
 
         assert(dynamic_cast<pfx::NullNode *>(iter.next().get()));
+        assert(iter.nextNode().as<pfx::NullNode>());
+        assert(iter.fetchNextNode().as<pfx::NullNode>());
     }
 
     {
@@ -84,35 +90,35 @@ int main()
         pfx::GroupNode *gn = dynamic_cast<pfx::GroupNode *>(n.get());
         assert(gn);
         assert(gn->nodes.size() == 1);
-        assert(gn->nodes[0].start.column == 5);
+        assert(gn->nodes[0].start.column() == 5);
 
         input = pfx::Input("", " \tx");
         n = ctx.compileCode(input);
         gn = dynamic_cast<pfx::GroupNode *>(n.get());
         assert(gn);
         assert(gn->nodes.size() == 1);
-        assert(gn->nodes[0].start.column == 5);
+        assert(gn->nodes[0].start.column() == 5);
 
         input = pfx::Input("", "  \tx");
         n = ctx.compileCode(input);
         gn = dynamic_cast<pfx::GroupNode *>(n.get());
         assert(gn);
         assert(gn->nodes.size() == 1);
-        assert(gn->nodes[0].start.column == 5);
+        assert(gn->nodes[0].start.column() == 5);
 
         input = pfx::Input("", "   \tx");
         n = ctx.compileCode(input);
         gn = dynamic_cast<pfx::GroupNode *>(n.get());
         assert(gn);
         assert(gn->nodes.size() == 1);
-        assert(gn->nodes[0].start.column == 5);
+        assert(gn->nodes[0].start.column() == 5);
 
         input = pfx::Input("", "    \tx");
         n = ctx.compileCode(input);
         gn = dynamic_cast<pfx::GroupNode *>(n.get());
         assert(gn);
         assert(gn->nodes.size() == 1);
-        assert(gn->nodes[0].start.column == 9);
+        assert(gn->nodes[0].start.column() == 9);
     }
 
     {
@@ -123,4 +129,1362 @@ int main()
         assert(pfx::readWord(input, t));
         assert(t.word == R"(Quoted string "like this".)");
     }
-}
\ No newline at end of file
+
+    {
+        printf("Mapped file input.\n");
+        char fn[] = "/tmp/pfx_test_XXXXXX";
+        int fd = mkstemp(fn);
+        assert(fd >= 0);
+        const char src[] = "foo\n  \"bar\"\n";
+        assert(write(fd, src, sizeof(src) - 1) == sizeof(src) - 1);
+        close(fd);
+
+        pfx::Input input(fn);
+        pfx::Token t;
+        assert(pfx::readWord(input, t));
+        assert(t.word == "foo");
+        assert(t.start.line() == 1 && t.start.column() == 1);
+        assert(pfx::readWord(input, t));
+        assert(t.word == "bar" && t.quoted);
+        assert(t.start.line() == 2 && t.start.column() == 3);
+        assert(!pfx::readWord(input, t));
+        unlink(fn);
+    }
+
+    {
+        printf("Borrowed strings outlive the input.\n");
+        pfx::Context ctx;
+        pfx::GroupRef gn;
+        {
+            pfx::Input input("", R"( "plain" "esc""aped" )");
+            gn = ctx.compileCode(input);
+        }
+        assert(gn->nodes.size() == 2);
+        assert(gn->nodes[0].node->toString() == "plain");
+        assert(gn->nodes[1].node->toString() == R"(esc"aped)");
+
+        pfx::Input input("", R"( "a""b" )");
+        pfx::Token t;
+        assert(pfx::readWord(input, t));
+        pfx::Token copy = t;
+        t = pfx::Token();
+        assert(copy.escaped && copy.word == R"(a"b)");
+    }
+
+    {
+        printf("Token table matches readWord.\n");
+        const char alphabet[] = " \t\r\n\"\"ab()";
+        unsigned seed = 12345;
+        for (int round = 0; round < 2000; round++)
+        {
+            std::string src;
+            int len = round % 150;
+            for (int i = 0; i < len; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                src.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+            }
+
+            pfx::TokenTable table;
+            pfx::tokenize(src.data(), src.data() + src.size(), table);
+
+            pfx::Input input("", src);
+            pfx::Token t;
+            size_t n = 0;
+            while (pfx::readWord(input, t))
+            {
+                assert(n < table.size());
+                std::string text(table.text(src.data(), n));
+                if (table.flags[n] & pfx::TokenTable::Escaped)
+                {
+                    text = pfx::unescapeQuotes(text);
+                }
+                assert(t.quoted == bool(table.flags[n] & pfx::TokenTable::Quoted));
+                assert(t.word == text);
+                n++;
+            }
+            assert(n == table.size());
+        }
+    }
+
+    {
+        printf("Lazy line and column computation.\n");
+        pfx::Context ctx;
+        pfx::Input input("lines", "a\r\nb\r\n  \tc\rd\r\re");
+        pfx::GroupRef gn = ctx.compileCode(input);
+        assert(gn->nodes.size() == 5);
+        assert(gn->nodes[2].start.line() == 3);
+        assert(gn->nodes[2].start.column() == 5);
+        assert(gn->nodes[3].start.line() == 4);
+        assert(gn->nodes[4].start.line() == 6);
+        assert(gn->nodes[4].start.toString() == "lines 6:1");
+
+        std::string message;
+        try
+        {
+            pfx::Input input("errors", "\n\n  undefined");
+            pfx::Context ctx;
+            ctx.compileCode(input)->evaluate();
+        }
+        catch (const pfx::Error &e)
+        {
+            message = e.toString();
+        }
+        assert(message == "errors 3:3: This command is undefined.");
+    }
+
+    {
+        printf("Word classification.\n");
+        using pfx::WordKind;
+        assert(pfx::classifyWord("42").kind == WordKind::Integer);
+        assert(pfx::classifyWord("-42").integer == -42);
+        assert(pfx::classifyWord("+42").integer == 42);
+        assert(pfx::classifyWord("42.5").floating == 42.5);
+        assert(pfx::classifyWord("1e3").kind == WordKind::Float);
+        assert(pfx::classifyWord(".5").floating == 0.5);
+        assert(pfx::classifyWord("+").kind == WordKind::Command);
+        assert(pfx::classifyWord("-").kind == WordKind::Command);
+        assert(pfx::classifyWord("+-1").kind == WordKind::Command);
+        assert(pfx::classifyWord("1e").kind == WordKind::Command);
+        assert(pfx::classifyWord("42x").kind == WordKind::Command);
+        assert(pfx::classifyWord("foo").kind == WordKind::Command);
+        // Out of int range, becomes a float instead of being truncated.
+        pfx::WordClass big = pfx::classifyWord("3000000000");
+        assert(big.kind == WordKind::Float && big.floating == 3e9);
+        pfx::WordClass huge = pfx::classifyWord("1e999");
+        assert(huge.kind == WordKind::Float && huge.floating > 1e308);
+    }
+
+    {
+        printf("Literal interning.\n");
+        pfx::Context ctx;
+        pfx::Input input("", R"(1 1 5000 5000 2.5 2.5 "a" "a" ( 1 "a" ) ( 1 "a" ))");
+        pfx::GroupRef gn = ctx.compileCode(input);
+        for (int i = 0; i < 8; i += 2)
+        {
+            assert(gn->nodes[i].node == gn->nodes[i + 1].node);
+        }
+        assert(gn->nodes[8].node != gn->nodes[9].node);
+        assert(pfx::createInteger(7) == pfx::createInteger(7));
+        assert(pfx::createInteger(100000)->toInteger() == 100000);
+
+        ctx.setConstantGroupSharing(true);
+        input = pfx::Input("", "( 1 ( 2.5 ) ) ( 1 ( 2.5 ) ) ( 1 x )  ( 1 x )");
+        gn = ctx.compileCode(input);
+        assert(gn->nodes[0].node == gn->nodes[1].node);
+        assert(gn->nodes[2].node != gn->nodes[3].node);
+    }
+
+    {
+        printf("Arena compiled program.\n");
+        pfx::Context ctx;
+        pfx::Input input("", R"(( "a long string that is not pooled in the constant pool at all, it is borrowed" 2 ) x)");
+        pfx::GroupRef kept;
+        {
+            pfx::CompiledProgram program = ctx.compileProgram(input);
+            assert(program.getArena()->getUsed() > 0);
+            assert(program.getRoot()->nodes.size() == 2);
+            kept = program.getRoot()->nodes[0].node->asGroup();
+        }
+        // The arena lives as long as any of its nodes.
+        assert(kept->nodes.size() == 2);
+        assert(kept->nodes[1].node->toInteger() == 2);
+        assert(kept->nodes[0].node->toString().size() > 60);
+    }
+
+    {
+        printf("Intrusive node references.\n");
+        pfx::NodeRef a = pfx::makeNode<pfx::StringNode>(std::string("abc"));
+        assert(a.use_count() == 1);
+        pfx::NodeRef b = a;
+        assert(a.use_count() == 2 && a == b);
+        // A raw pointer can be readopted without a separate control block.
+        pfx::NodeRef c(b.get());
+        assert(a.use_count() == 3);
+        b.reset();
+        c = nullptr;
+        assert(a.use_count() == 1 && !b);
+        pfx::NodeRef self = a->evaluate();
+        assert(self == a && a.use_count() == 2);
+    }
+
+    {
+        printf("Unboxed values.\n");
+        pfx::Value i(42);
+        pfx::Value f(2.5);
+        pfx::Value n;
+        assert(i.isInteger() && i.getType() == pfx::NodeType::Integer);
+        assert(f.isFloat() && f.toInteger() == 2 && f.toString() == "2.5");
+        assert(n.getType() == pfx::NodeType::Null && n.toString() == "null");
+        assert(n.toNode() == pfx::NullNode::instance);
+        assert(i.toNode()->toInteger() == 42 && !i.getNode());
+
+        pfx::NodeRef str = pfx::createString("abc");
+        pfx::Value s = str;
+        assert(s.getNode() == str.get() && str.use_count() == 2);
+        s = i;
+        assert(str.use_count() == 1 && s.toInteger() == 42);
+
+        // Old style commands and value commands can call each other.
+        struct Twice : pfx::ValueCommand
+        {
+            pfx::Value call(pfx::ArgIterator &iter) override
+            {
+                return pfx::Value(iter.evaluateNextValue().toInteger() * 2);
+            }
+        };
+        struct Negate : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                return pfx::createInteger(-iter.evaluateNext()->toInteger());
+            }
+        };
+        pfx::Context ctx;
+        ctx.setCommand("twice", std::make_shared<Twice>());
+        ctx.setCommand("negate", std::make_shared<Negate>());
+        pfx::Input input("", "twice negate twice 5000");
+        pfx::GroupRef gn = ctx.compileCode(input);
+        pfx::Value v = gn->evaluateValue();
+        assert(v.isInteger() && v.toInteger() == -20000);
+        assert(gn->evaluate()->toInteger() == -20000);
+    }
+
+    {
+        printf("Symbol table.\n");
+        struct NopCommand : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &) override
+            {
+                return pfx::NullNode::instance;
+            }
+        };
+        pfx::Context ctx;
+        auto cmd = std::make_shared<NopCommand>();
+        for (int i = 0; i < 20; i++)
+        {
+            ctx.setCommand("builtin" + std::to_string(i), cmd);
+        }
+        ctx.sealCommands();
+        ctx.setCommand("later", cmd);
+        assert(ctx.getCommand("builtin7") == cmd);
+        assert(ctx.getCommand("later") == cmd);
+        assert(!ctx.getCommand("builtin"));
+
+        // Sealed commands can still be overwritten.
+        auto other = std::make_shared<NopCommand>();
+        ctx.setCommand("builtin3", other);
+        assert(ctx.getCommand("builtin3") == other);
+
+        std::string code;
+        for (int i = 0; i < 3000; i++)
+        {
+            code += "undefined" + std::to_string(i) + " builtin" +
+                    std::to_string(i % 20) + " ";
+        }
+        // Undefined commands are kept while the code using them is alive.
+        pfx::Input input("", "undefined1");
+        pfx::GroupRef kept = ctx.compileCode(input);
+        input = pfx::Input("", code);
+        pfx::GroupRef gn = ctx.compileCode(input);
+        assert(gn->nodes[1].node->asCommand()->getCommand() == cmd);
+        assert(ctx.getCommand("undefined0"));
+
+        gn.reset();
+        input = pfx::Input("", "builtin0");
+        ctx.compileCode(input);
+        assert(!ctx.getCommand("undefined0"));
+        assert(ctx.getCommand("undefined1"));
+        assert(ctx.getCommand("builtin0") == cmd);
+        assert(ctx.getCommand("later") == cmd);
+
+        // The sealed commands are counted once, when they are sealed.
+        pfx::SymbolTable table;
+        for (const char *name : {"a", "b", "c"})
+        {
+            table.insert(pfx::makeNode<pfx::CommandNode>(cmd, name));
+        }
+        table.seal();
+        table.insert(pfx::makeNode<pfx::CommandNode>(cmd, "d"));
+        assert((table.sealedCount() == 3) && (table.size() == 4));
+        table.seal();
+        assert((table.sealedCount() == 4) && table.find("d"));
+    }
+
+    {
+        printf("Bytecode engine.\n");
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+        // Reads a count, then sums that many evaluated arguments.
+        struct Sum : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                int n = iter.evaluateNext()->toInteger();
+                int sum = 0;
+                while (n-- > 0)
+                {
+                    sum += iter.evaluateNext()->toInteger();
+                }
+                return pfx::createInteger(sum);
+            }
+        };
+        // Declares its shape, but is written against the iterator.
+        struct Pick : pfx::Command
+        {
+            Pick()
+            {
+                setSignature({pfx::ArgMode::Evaluate, pfx::ArgMode::Fetch,
+                              pfx::ArgMode::Fetch});
+            }
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                int which = iter.evaluateNext()->toInteger();
+                pfx::NodeRef a = iter.fetchNext();
+                pfx::NodeRef b = iter.fetchNext();
+                return (which ? a : b)->evaluate();
+            }
+        };
+        struct Quote : pfx::FixedCommand
+        {
+            Quote() : FixedCommand({pfx::ArgMode::Fetch})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return args[0];
+            }
+        };
+
+        // Each line is a group, so the engine under test evaluates it.
+        const char *code = R"(
+            ( + 1 sum 3 + 2 2 10 ( 5 + 1 1 ) )
+            ( pick + 0 1 ( sum 2 40 2 ) 7 )
+            ( pick 0 ( 1 ) + 1 sum 1 + 20 20 )
+            ( quote ( 1 2 ) )
+            ( + + 1 2 ) )";
+        std::vector<std::string> results[2];
+        for (int bytecode = 0; bytecode < 2; bytecode++)
+        {
+            pfx::Context ctx;
+            ctx.setCommand("+", std::make_shared<Add>());
+            ctx.setCommand("sum", std::make_shared<Sum>());
+            ctx.setCommand("pick", std::make_shared<Pick>());
+            ctx.setCommand("quote", std::make_shared<Quote>());
+            ctx.setBytecodeCompilation(bytecode);
+            pfx::Input input("", code);
+            pfx::GroupRef gn = ctx.compileCode(input);
+            for (const pfx::NodeInfo &info : gn->nodes)
+            {
+                pfx::GroupRef line = info.node->asGroup();
+                assert(!line->bytecode == !bytecode);
+                results[bytecode].push_back(line->evaluate()->toString());
+            }
+        }
+        assert(results[0] == results[1]);
+        // The fetched + runs without arguments, the last + misses one.
+        assert((results[0] ==
+                std::vector<std::string>{"17", "42", "40", "12", "3"}));
+
+        // Replacing a child keeps the count, the old code must not run.
+        pfx::Context ctx;
+        ctx.setCommand("+", std::make_shared<Add>());
+        ctx.setBytecodeCompilation(true);
+        pfx::Input input("", "( 1 ( 2 3 ) )");
+        pfx::GroupRef gn = ctx.compileCode(input);
+        pfx::GroupRef outer = gn->nodes[0].node->asGroup();
+        pfx::GroupRef inner = outer->nodes[1].node->asGroup();
+        assert(outer->evaluate()->toInteger() == 3);
+        inner->nodes[1].node = pfx::createInteger(4);
+        assert(outer->evaluate()->toInteger() == 4);
+        outer->nodes[1].node = pfx::createInteger(5);
+        assert(outer->evaluate()->toInteger() == 5);
+        outer->compileBytecode();
+        assert(outer->evaluate()->toInteger() == 5);
+    }
+
+    {
+        printf("Call linking.\n");
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+        // Written against the iterator, the signature is registered with it.
+        struct Negate : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                return pfx::createInteger(-iter.evaluateNext()->toInteger());
+            }
+        };
+        // No signature, nobody knows where its arguments end.
+        struct Sum : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                int n = iter.evaluateNext()->toInteger();
+                int sum = 0;
+                while (n-- > 0)
+                {
+                    sum += iter.evaluateNext()->toInteger();
+                }
+                return pfx::createInteger(sum);
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            ctx.setCommand("+", std::make_shared<Add>());
+            ctx.setCommand("neg", std::make_shared<Negate>(),
+                           {pfx::ArgMode::Evaluate});
+            ctx.setCommand("sum", std::make_shared<Sum>());
+            ctx.setBytecodeCompilation(bytecode);
+            ctx.setCallLinking(true);
+
+            pfx::Input input("", "+ 1 neg + 2 ( 3 ) + 1 sum 2 3 4");
+            pfx::GroupRef gn = ctx.compileCode(input);
+            // The first call is linked, the second waits for sum.
+            assert(gn->nodes.size() == 7);
+            assert(gn->nodes[0].node->getType() == pfx::NodeType::Call);
+            assert(gn->nodes[1].node->getType() == pfx::NodeType::Command);
+            assert(gn->evaluate()->toInteger() == 8);
+
+            pfx::Input input2("", "+ 1 neg + 2 ( 3 )");
+            pfx::GroupRef gn2 = ctx.compileCode(input2);
+            assert(gn2->evaluate()->toInteger() == -4);
+
+            // The arity errors are found during the compilation.
+            bool missing = false;
+            try
+            {
+                pfx::Input input3("", "+ 1 ( neg )");
+                ctx.compileCode(input3);
+            }
+            catch (const pfx::error::MissingArgument &e)
+            {
+                missing = e.position.offset == 6;
+            }
+            assert(missing);
+
+            // The linked calls refuse a command of a different shape.
+            ctx.setCommand("neg", std::make_shared<Add>());
+            bool changed = false;
+            try
+            {
+                gn2->evaluate();
+            }
+            catch (const pfx::error::RuntimeError &)
+            {
+                changed = true;
+            }
+            assert(changed);
+        }
+
+        // A signature can't be given to a command that has another one.
+        bool refused = false;
+        try
+        {
+            pfx::Context ctx;
+            ctx.setCommand("+", std::make_shared<Add>(),
+                           {pfx::ArgMode::Fetch});
+        }
+        catch (const pfx::error::InvalidOperation &e)
+        {
+            refused = e.reason.find("'+'") != std::string::npos;
+        }
+        assert(refused);
+    }
+
+    {
+        printf("Type tag casts.\n");
+        // Reports a type, but it's not a library class.
+        struct Impostor : pfx::Node
+        {
+            std::string toString() const override
+            {
+                return "";
+            }
+            int toInteger() const override
+            {
+                return 0;
+            }
+            double toDouble() const override
+            {
+                return 0.0;
+            }
+            pfx::NodeType getType() const override
+            {
+                return pfx::NodeType::Group;
+            }
+        };
+        pfx::NodeRef integer = pfx::createInteger(1000);
+        assert(integer->as<pfx::IntegerNode>()->value == 1000);
+        assert(!integer->as<pfx::FloatNode>());
+        assert(!integer->asGroup());
+        pfx::NodeRef impostor = pfx::makeNode<Impostor>();
+        assert(!impostor->as<pfx::GroupNode>() && !impostor->asGroup());
+        assert(pfx::NullNode::instance->as<pfx::NullNode>());
+
+        struct Tagged : pfx::Command
+        {
+            Tagged()
+            {
+                setTag<Tagged>();
+            }
+            pfx::NodeRef execute(pfx::ArgIterator &) override
+            {
+                return pfx::NullNode::instance;
+            }
+        };
+        struct Untagged : Tagged
+        {
+        };
+        struct Other : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &) override
+            {
+                return pfx::NullNode::instance;
+            }
+        };
+        Tagged tagged;
+        Untagged untagged;
+        Other other;
+        assert(tagged.as<Tagged>() == &tagged);
+        // The derived class didn't tag itself, so it passes as its base.
+        assert(untagged.as<Tagged>() && !untagged.as<Untagged>());
+        assert(!other.as<Tagged>());
+    }
+
+    {
+        printf("Depth limit.\n");
+        // Deeper than the limit.
+        std::string code;
+        for (int i = 0; i < 100000; i++) code += "( ";
+        code += "42 ";
+        for (int i = 0; i < 100000; i++) code += ") ";
+
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            ctx.setBytecodeCompilation(bytecode);
+            ctx.setCallLinking(bytecode);
+            pfx::Input input("", code);
+            pfx::GroupRef gn = ctx.compileCode(input);
+            assert(gn->toString() == "42");
+
+            // The bytecode engine keeps the nested groups on the heap.
+            pfx::DepthLimit::set(1000);
+            bool tooDeep = false;
+            try
+            {
+                assert(gn->evaluateValue().toInteger() == 42);
+            }
+            catch (const pfx::error::TooDeep &)
+            {
+                tooDeep = true;
+            }
+            pfx::DepthLimit::set(pfx::DepthLimit::defaultLimit);
+            assert(tooDeep == !bytecode);
+
+        }
+    }
+
+    {
+        printf("Borrowed arguments.\n");
+        // Reports the references of its fetched argument, keeps the last one.
+        struct Inspect : pfx::FixedCommand
+        {
+            int refCount = 0;
+            pfx::Value kept;
+
+            Inspect() : FixedCommand({pfx::ArgMode::Fetch})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                refCount = args[0].getNode()->getRefCount();
+                kept = args[0];
+                return pfx::Value();
+            }
+        };
+        auto inspect = std::make_shared<Inspect>();
+
+        for (bool bytecode : {false, true})
+        {
+            for (bool linking : {false, true})
+            {
+                pfx::Context ctx;
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCallLinking(linking);
+                ctx.setCommand("inspect", inspect);
+                pfx::Input input("", "inspect ( 1 2 )");
+                pfx::GroupRef gn = ctx.compileCode(input);
+                const pfx::Node *group =
+                    gn->nodes.back().node->as<pfx::GroupNode>()
+                        ? gn->nodes.back().node.get()
+                        : gn->nodes[0].node->as<pfx::CallNode>()
+                              ->args[0]
+                              .node.get();
+                int before = group->getRefCount();
+
+                gn->evaluateValue();
+                // Reading the argument didn't take a reference, keeping it
+                // did.
+                assert(inspect->refCount == before);
+                assert(inspect->kept.getNode() == group);
+                assert(group->getRefCount() == before + 1);
+                inspect->kept = pfx::Value();
+            }
+        }
+    }
+
+    {
+        printf("Variables.\n");
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+        // Stands for a variable until it's bound to one.
+        struct Zero : pfx::FixedCommand
+        {
+            Zero() : FixedCommand(pfx::Signature())
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &) override
+            {
+                return pfx::Value(0);
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            for (bool linking : {false, true})
+            {
+                pfx::Context ctx;
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCallLinking(linking);
+                ctx.setCommand("+", std::make_shared<Add>());
+                ctx.setCommand("y", std::make_shared<Zero>());
+                ctx.setVariable("x", pfx::Value(40));
+                pfx::Input input("", "+ + x y 2");
+                pfx::GroupRef gn = ctx.compileCode(input);
+                assert(gn->evaluateValue().toInteger() == 42);
+
+                // The nodes read the new bindings.
+                ctx.setVariable("y", pfx::Value(100));
+                assert(ctx.getVariable("y").toInteger() == 100);
+                assert(!ctx.getCommand("y"));
+                assert(gn->evaluateValue().toInteger() == 142);
+
+                ctx.setCommand("x", std::make_shared<Zero>());
+                assert(ctx.getVariable("x").getType() == pfx::NodeType::Null);
+                assert(gn->evaluateValue().toInteger() == 102);
+            }
+        }
+    }
+
+    {
+        printf("Quickening.\n");
+        static int fastCalls = 0;
+        struct Add : pfx::FixedCommand
+        {
+            int genericCalls = 0;
+
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+                setTag<Add>();
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                genericCalls++;
+                return pfx::Value(args[0].toDouble() + args[1].toDouble());
+            }
+            const pfx::Quickening *
+            quicken(const pfx::Arguments &args) const override
+            {
+                static const pfx::Quickening integers =
+                    pfx::Quickening::of<Add>(
+                        {pfx::NodeType::Integer, pfx::NodeType::Integer},
+                        [](const pfx::Arguments &args) {
+                            fastCalls++;
+                            return pfx::Value(args[0].toInteger() +
+                                              args[1].toInteger());
+                        });
+                return integers.accepts(args) ? &integers : nullptr;
+            }
+        };
+        struct Sub : pfx::FixedCommand
+        {
+            Sub()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() - args[1].toInteger());
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            for (bool linking : {false, true})
+            {
+                // Only the linked calls and the bytecode have call sites.
+                bool quickens = bytecode || linking;
+                auto add = std::make_shared<Add>();
+                pfx::Context ctx;
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCallLinking(linking);
+                ctx.setCommand("+", add);
+                ctx.setVariable("x", pfx::Value(40));
+                pfx::Input input("", "+ x 2");
+                pfx::GroupRef gn = ctx.compileCode(input);
+                fastCalls = 0;
+
+                // The first call already takes the fast path.
+                assert(gn->evaluateValue().toInteger() == 42);
+                assert(gn->evaluateValue().toInteger() == 42);
+                assert(fastCalls == (quickens ? 2 : 0));
+                assert(add->genericCalls == (quickens ? 0 : 2));
+
+                // The guard fails, the generic path gives the result.
+                ctx.setVariable("x", pfx::Value(0.5));
+                assert(gn->evaluateValue().toDouble() == 2.5);
+                assert(add->genericCalls == (quickens ? 1 : 3));
+
+                // The site stays generic.
+                ctx.setVariable("x", pfx::Value(40));
+                assert(gn->evaluateValue().toInteger() == 42);
+                assert(fastCalls == (quickens ? 2 : 0));
+
+                // Another command doesn't take the fast path of the old one.
+                ctx.setCommand("+", std::make_shared<Sub>());
+                assert(gn->evaluateValue().toInteger() == 38);
+            }
+        }
+
+        // A quickened site checks the class of the command.
+        for (bool bytecode : {false, true})
+        {
+            pfx::Context ctx;
+            ctx.setBytecodeCompilation(bytecode);
+            ctx.setCallLinking(true);
+            ctx.setCommand("+", std::make_shared<Add>());
+            pfx::Input input("", "+ 40 2");
+            pfx::GroupRef gn = ctx.compileCode(input);
+            assert(gn->evaluateValue().toInteger() == 42);
+            ctx.setCommand("+", std::make_shared<Sub>());
+            assert(gn->evaluateValue().toInteger() == 38);
+        }
+    }
+
+    {
+        printf("Cache slots.\n");
+        static int setups = 0;
+        // Reads the factor from the cache of its site.
+        struct Twice : pfx::Command
+        {
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                const pfx::CacheSlot *cache = iter.getCache();
+                int value = iter.evaluateNextValue().toInteger();
+                // The arguments don't change the site.
+                assert(iter.getCache() == cache);
+                const int &factor = cache->get<int>([] {
+                    setups++;
+                    return 2;
+                });
+                return pfx::makeNode<pfx::IntegerNode>(value * factor);
+            }
+        };
+        struct Triple : pfx::FixedCommand
+        {
+            Triple() : FixedCommand({pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                const int &factor = args.getCache()->get<int>([] {
+                    setups++;
+                    return 3;
+                });
+                return pfx::Value(args[0].toInteger() * factor);
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            for (bool linking : {false, true})
+            {
+                pfx::Context ctx;
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCallLinking(linking);
+                ctx.setCommand("twice", std::make_shared<Twice>());
+                ctx.setCommand("triple", std::make_shared<Triple>());
+                pfx::Input input(
+                    "", "twice triple 1 ( twice 2 ) triple triple 3");
+                pfx::GroupRef gn = ctx.compileCode(input);
+                setups = 0;
+
+                // Each of the five sites is set up once.
+                assert(gn->evaluateValue().toInteger() == 27);
+                assert(setups == 5);
+                assert(gn->evaluateValue().toInteger() == 27);
+                assert(gn->evaluateAll()->nodes[0].node->toInteger() == 6);
+                assert(setups == 5);
+            }
+        }
+
+        pfx::CacheSlot slot;
+        const int &number = slot.get<int>([] { return 1; });
+        const std::string &text =
+            slot.get<std::string>([] { return std::string("one"); });
+        // The replaced object is kept.
+        assert((number == 1) && (text == "one"));
+        assert(&slot.get<std::string>([] { return std::string(); }) == &text);
+
+        // A copy is another site.
+        pfx::CacheSlot copy(slot);
+        assert(copy.get<std::string>([] { return std::string(); }).empty());
+    }
+
+    {
+        printf("Environments.\n");
+        struct Set : pfx::FixedCommand
+        {
+            Set() : FixedCommand({pfx::ArgMode::Fetch, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                args[0].asCommand()->setValue(args[1]);
+                return args[1];
+            }
+        };
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            for (bool linking : {false, true})
+            {
+                pfx::Context ctx;
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCallLinking(linking);
+                ctx.setCommand("set", std::make_shared<Set>());
+                ctx.setCommand("+", std::make_shared<Add>());
+                ctx.setVariable("x", pfx::Value(1));
+                pfx::Input input("", "set x + x 1 x");
+                pfx::GroupRef gn = ctx.compileCode(input);
+
+                // The changes stay in the environment.
+                pfx::Environment first;
+                assert(first.evaluate(*gn).toInteger() == 2);
+                assert(first.evaluate(*gn).toInteger() == 3);
+                assert(ctx.getVariable("x").toInteger() == 1);
+                {
+                    pfx::Environment::Scope scope(first);
+                    assert(ctx.getVariable("x").toInteger() == 3);
+                }
+                pfx::Environment second;
+                assert(second.evaluate(*gn).toInteger() == 2);
+                first.clear();
+                assert(first.evaluate(*gn).toInteger() == 2);
+
+                // Without one they change the shared bindings.
+                assert(gn->evaluateValue().toInteger() == 2);
+                assert(ctx.getVariable("x").toInteger() == 2);
+
+                // The threads run the same program with their own bindings.
+                const int runs = 1000;
+                int results[4] = {};
+                std::vector<std::thread> threads;
+                for (int &result : results)
+                {
+                    threads.emplace_back([&gn, &result] {
+                        pfx::Environment environment;
+                        for (int i = 0; i < runs; i++)
+                        {
+                            result = environment.evaluate(*gn).toInteger();
+                        }
+                    });
+                }
+                for (std::thread &thread : threads)
+                {
+                    thread.join();
+                }
+                for (int result : results)
+                {
+                    assert(result == 2 + runs);
+                }
+                assert(ctx.getVariable("x").toInteger() == 2);
+
+                // Many bindings, in an environment and in its child.
+                std::string code;
+                for (int i = 0; i < 100; i++)
+                {
+                    std::string name = "v" + std::to_string(i);
+                    ctx.setVariable(name, pfx::Value(0));
+                    code += " set " + name + " " + std::to_string(i);
+                }
+                pfx::Input many("", code);
+                pfx::GroupRef setter = ctx.compileCode(many);
+                pfx::Environment parent;
+                parent.evaluate(*setter);
+                pfx::Environment child(&parent);
+                pfx::Input one("", "set v7 + v7 100");
+                child.evaluate(*ctx.compileCode(one));
+                for (int i = 0; i < 100; i++)
+                {
+                    std::string name = "v" + std::to_string(i);
+                    assert(ctx.getVariable(name).toInteger() == 0);
+                    {
+                        pfx::Environment::Scope scope(parent);
+                        assert(ctx.getVariable(name).toInteger() == i);
+                    }
+                    pfx::Environment::Scope scope(child);
+                    assert(ctx.getVariable(name).toInteger() ==
+                           (i == 7 ? 107 : i));
+                }
+            }
+        }
+    }
+
+    {
+        printf("Purity.\n");
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+                setPure();
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+        // Not pure, it records the order of the calls.
+        struct Record : pfx::FixedCommand
+        {
+            std::vector<int> calls;
+            Record() : FixedCommand({pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                calls.push_back(args[0].toInteger());
+                return args[0];
+            }
+        };
+        // Pure, but the arguments it reads are unknown.
+        struct Twice : pfx::Command
+        {
+            Twice()
+            {
+                setPure();
+            }
+            pfx::NodeRef execute(pfx::ArgIterator &iter) override
+            {
+                return pfx::makeNode<pfx::IntegerNode>(
+                    iter.evaluateNext()->toInteger() * 2);
+            }
+        };
+        // Pure, it fails with its argument as the reason.
+        struct Fail : pfx::FixedCommand
+        {
+            Fail() : FixedCommand({pfx::ArgMode::Evaluate})
+            {
+                setPure();
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                throw pfx::error::RuntimeError(
+                    args.getPosition(0), std::to_string(args[0].toInteger()));
+            }
+        };
+
+        for (bool linking : {false, true})
+        {
+            pfx::Context ctx;
+            ctx.setThreadCount(2);
+            ctx.setCallLinking(linking);
+            auto record = std::make_shared<Record>();
+            ctx.setCommand("+", std::make_shared<Add>());
+            ctx.setCommand("record", record);
+            ctx.setCommand("twice", std::make_shared<Twice>());
+            ctx.setCommand("fail", std::make_shared<Fail>());
+            ctx.setVariable("x", pfx::Value(10));
+            pfx::ThreadPool &pool = ctx.getThreadPool();
+#ifndef PFX_SINGLE_THREADED
+            assert(pool.size() == 2);
+#endif
+
+            auto evaluate = [&ctx, &pool](const char *code) {
+                pfx::Input input("", code);
+                return ctx.compileCode(input)->evaluateAll(pool);
+            };
+            auto check = [](const pfx::GroupRef &group,
+                            std::vector<int> expected) {
+                assert(group->nodes.size() == expected.size());
+                for (size_t i = 0; i < expected.size(); i++)
+                {
+                    assert(group->nodes[i].node->toInteger() == expected[i]);
+                }
+            };
+
+            // The pure expressions keep their order.
+            std::string code;
+            std::vector<int> expected;
+            for (int i = 0; i < 100; i++)
+            {
+                code += " + x + " + std::to_string(i) + " 1";
+                expected.push_back(11 + i);
+            }
+            check(evaluate(code.c_str()), expected);
+            check(evaluate("7 + 1 2 x"), {7, 3, 10});
+
+            // An impure command runs them in sequence.
+            check(evaluate("+ 1 2 record 1 record 2 record + 1 2"),
+                  {3, 1, 2, 3});
+            assert((record->calls == std::vector<int>{1, 2, 3}));
+
+            // So does one that reads its arguments itself.
+            check(evaluate("+ 1 2 twice 4 + 2 2"), {3, 8, 4});
+
+            // The error is the one of the first failing expression.
+            std::string failing;
+            for (int i = 0; i < 200; i++)
+            {
+                failing += (i % 50 == 49) ? " fail " + std::to_string(i)
+                                          : std::string(" + 1 1");
+            }
+            for (int run = 0; run < 20; run++)
+            {
+                std::string reason;
+                try
+                {
+                    evaluate(failing.c_str());
+                }
+                catch (const pfx::Error &e)
+                {
+                    reason = e.reason;
+                }
+                assert(reason == "49");
+            }
+
+            // The undefined names are not pure, they run in sequence.
+            pfx::PurityCheck purity;
+            pfx::Input undefined("", "+ 1 2 undefined");
+            assert(!purity.isPure(*ctx.compileCode(undefined)));
+
+            // The variables of the caller's environment are seen.
+            pfx::Environment environment;
+            pfx::Environment::Scope scope(environment);
+            ctx.setVariable("x", pfx::Value(20));
+            check(evaluate("+ x 1 + x 2"), {21, 22});
+        }
+    }
+
+    {
+        printf("Parallel map.\n");
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+                setPure();
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+        // Not pure, it records the order of the calls.
+        struct Record : pfx::FixedCommand
+        {
+            std::vector<int> calls;
+            Record() : FixedCommand({pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                calls.push_back(args[0].toInteger());
+                return args[0];
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            auto record = std::make_shared<Record>();
+            std::string elements;
+            std::vector<int> expected;
+            for (int i = 0; i < 200; i++)
+            {
+                elements += " " + std::to_string(i);
+                expected.push_back(i);
+            }
+
+            pfx::GroupRef program;
+            {
+                pfx::Context ctx;
+                cpfx::applyCommonPfx(ctx);
+                ctx.setThreadCount(2);
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCommand("+", std::make_shared<Add>());
+                ctx.setCommand("record", record);
+
+                pfx::Input input("", R"(
+                    bind inc lambda ( x ) ( ) ( + x 1 )
+                    bind log lambda ( x ) ( ) ( record x )
+                    fetch (
+                        ( pmap fetch inc fetch ()" + elements + R"( ) )
+                        ( pmap fetch log fetch ()" + elements + R"( ) )
+                    )
+                )");
+                program = ctx.compileCode(input);
+            }
+
+            // The commands keep the pool, the context is gone.
+            pfx::GroupRef maps = program->evaluate()->asGroup();
+            assert(maps && (maps->nodes.size() == 2));
+
+            // The results are in the order of the elements.
+            pfx::GroupRef incremented =
+                maps->nodes[0].node->evaluate()->asGroup();
+            assert(incremented && (incremented->nodes.size() == 200));
+            for (int i = 0; i < 200; i++)
+            {
+                assert(incremented->nodes[i].node->toInteger() == i + 1);
+            }
+
+            // An impure command maps the elements one by one.
+            pfx::GroupRef logged = maps->nodes[1].node->evaluate()->asGroup();
+            assert(logged && (logged->nodes.size() == 200));
+            assert(record->calls == expected);
+        }
+    }
+
+    {
+        printf("Parallel compilation.\n");
+        struct Add : pfx::FixedCommand
+        {
+            Add()
+                : FixedCommand({pfx::ArgMode::Evaluate, pfx::ArgMode::Evaluate})
+            {
+            }
+            pfx::Value apply(const pfx::Arguments &args) override
+            {
+                return pfx::Value(args[0].toInteger() + args[1].toInteger());
+            }
+        };
+
+        for (bool bytecode : {false, true})
+        {
+            for (bool linking : {false, true})
+            {
+                pfx::Context ctx;
+                ctx.setThreadCount(2);
+                ctx.setBytecodeCompilation(bytecode);
+                ctx.setCallLinking(linking);
+                ctx.setCommand("+", std::make_shared<Add>());
+
+                // The inputs keep pointers to their names.
+                std::vector<std::string> names(20);
+                std::vector<std::unique_ptr<pfx::Input>> inputs;
+                std::vector<pfx::Input *> pointers;
+                for (int i = 0; i < 20; i++)
+                {
+                    std::string code = "+ " + std::to_string(i) +
+                                       " 3 ( + 1 2 ) \"s\" later missing";
+                    names[i] = "f" + std::to_string(i);
+                    inputs.push_back(
+                        std::make_unique<pfx::Input>(names[i].c_str(), code));
+                    pointers.push_back(inputs.back().get());
+                }
+                std::vector<pfx::GroupRef> roots = ctx.compileCode(pointers);
+                assert(roots.size() == 20);
+
+                // The names get one node, made by the first input using it.
+                const pfx::Node *missing = nullptr;
+                for (int i = 0; i < 20; i++)
+                {
+                    pfx::GroupRef root = roots[i];
+                    assert(root->source == inputs[i]->getSourceMap());
+                    const pfx::Node *node = root->nodes.back().node.get();
+                    assert(!missing || (node == missing));
+                    missing = node;
+                }
+                try
+                {
+                    roots[5]->evaluate();
+                    assert(false);
+                }
+                catch (const pfx::error::UndefinedCommand &e)
+                {
+                    assert(e.location.find("f0 ") == 0);
+                }
+
+                // Defined later, they are bound like the sequential ones.
+                ctx.setVariable("later", pfx::Value(7));
+                ctx.setVariable("missing", pfx::Value(8));
+                pfx::Input input("", "later missing");
+                pfx::GroupRef sequential = ctx.compileCode(input);
+                assert(sequential->nodes[1].node.get() == missing);
+                for (int i = 0; i < 20; i++)
+                {
+                    pfx::GroupRef result = roots[i]->evaluateAll();
+                    assert(result->nodes[0].node->toInteger() == i + 3);
+                    assert(result->nodes[1].node->toInteger() == 3);
+                    assert(result->nodes[2].node->toString() == "s");
+                    assert(result->nodes[3].node->toInteger() == 7);
+                    assert(result->nodes[4].node->toInteger() == 8);
+                }
+
+                // The error of the first failing input is thrown.
+                pfx::Input good("good", "+ 1 2");
+                pfx::Input unclosed("unclosed", "( + 1 2");
+                pfx::Input unopened("unopened", "+ 1 2 )");
+                try
+                {
+                    ctx.compileCode({&good, &unopened, &unclosed});
+                    assert(false);
+                }
+                catch (const pfx::error::ClosingBraceWithoutOpeningOne &e)
+                {
+                    assert(e.location.find("unopened") == 0);
+                }
+                assert(ctx.compileCode(std::vector<pfx::Input *>()).empty());
+            }
+        }
+    }
+
+    {
+        printf("Parallel tokenization.\n");
+        pfx::ThreadPool pool(3);
+        const char alphabet[] = " \t\r\n\"\"\"ab()";
+        unsigned seed = 54321;
+        for (int round = 0; round < 2000; round++)
+        {
+            std::string src;
+            int len = round % 300;
+            for (int i = 0; i < len; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                src.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+            }
+
+            pfx::TokenTable serial;
+            pfx::tokenize(src.data(), src.data() + src.size(), serial);
+            for (size_t chunkSize : {1, 7, 64})
+            {
+                pfx::TokenTable parallel;
+                pfx::tokenize(src.data(), src.data() + src.size(), parallel,
+                              pool, chunkSize);
+                assert(parallel.offsets == serial.offsets);
+                assert(parallel.lengths == serial.lengths);
+                assert(parallel.flags == serial.flags);
+            }
+        }
+
+        // A big source compiles to the same tree with and without threads.
+        std::string src;
+        for (int i = 0; src.size() < (8 << 20); i++)
+        {
+            src += "( set x" + std::to_string(i % 100) + " " +
+                   std::to_string(i) + " \"a string\nwith \"\"quotes\"\"\" " +
+                   std::to_string(i) + ".5 )\n";
+        }
+        pfx::Context serialCtx;
+        serialCtx.setThreadCount(0);
+        pfx::Context parallelCtx;
+        parallelCtx.setThreadCount(3);
+        pfx::Input serialInput("", src);
+        pfx::Input parallelInput("", src);
+        pfx::GroupRef expected = serialCtx.compileCode(serialInput);
+        pfx::GroupRef actual = parallelCtx.compileCode(parallelInput);
+        std::vector<std::pair<const pfx::GroupNode *, const pfx::GroupNode *>>
+            pending{{expected.get(), actual.get()}};
+        size_t nodes = 0;
+        while (!pending.empty())
+        {
+            auto [a, b] = pending.back();
+            pending.pop_back();
+            assert(a->nodes.size() == b->nodes.size());
+            for (size_t i = 0; i < a->nodes.size(); i++)
+            {
+                const pfx::NodeInfo &x = a->nodes[i];
+                const pfx::NodeInfo &y = b->nodes[i];
+                assert(x.node->getType() == y.node->getType());
+                assert(x.start.offset == y.start.offset);
+                assert(x.end.offset == y.end.offset);
+                assert(x.node->toString() == y.node->toString());
+                if (auto group = x.node->asGroup())
+                {
+                    pending.push_back({group.get(), y.node->asGroup().get()});
+                }
+                nodes++;
+            }
+        }
+        assert(nodes > 500000);
+    }
+
+    {
+        printf("Thread pool resizing.\n");
+        pfx::ThreadPool pool(2);
+        std::atomic<int> sum(0);
+        pool.run(10, [&](size_t i) { sum += int(i); });
+        // An idle pool can be resized after it ran.
+        pool.resize(3);
+        pool.run(10, [&](size_t i) { sum += int(i); });
+        assert(sum == 90);
+
+#ifndef PFX_SINGLE_THREADED
+        // But not from a loop running on it.
+        std::string reason;
+        try
+        {
+            pool.run(1, [&](size_t) { pool.resize(1); });
+        }
+        catch (const pfx::error::InvalidOperation &e)
+        {
+            reason = e.reason;
+        }
+        assert(reason.find("resized") != std::string::npos);
+#endif
+    }
+}